@@ -0,0 +1 @@
+g++ -std=c++17 -O2 -march=native src/benchmark.cpp src/Link.cpp src/CouplerHead.cpp src/FourBarMechanism.cpp src/MechanismBatch.cpp src/Field.cpp src/CouplerCurve.cpp src/FitnessCache.cpp src/Optimizer.cpp src/WorkStealingPool.cpp -pthread  -Wall -o benchmark
\ No newline at end of file
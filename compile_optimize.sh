@@ -1 +1 @@
-g++ -std=c++17 -O2 src/optimize.cpp src/Link.cpp src/CouplerHead.cpp src/FourBarMechanism.cpp src/Field.cpp src/Optimizer.cpp -pthread  -Wall -o optimize
\ No newline at end of file
+g++ -std=c++17 -O2 src/optimize.cpp src/Link.cpp src/CouplerHead.cpp src/FourBarMechanism.cpp src/Field.cpp src/CouplerCurve.cpp src/FitnessCache.cpp src/Optimizer.cpp src/WorkStealingPool.cpp -pthread  -Wall -o optimize
\ No newline at end of file
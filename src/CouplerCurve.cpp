@@ -0,0 +1,49 @@
+#include "CouplerCurve.h"
+
+CouplerCurve::CouplerCurve()
+{
+    this->segment_ended = true;
+}
+
+void CouplerCurve::reserve(int capacity)
+{
+    for (std::vector<double> *column : {&crank_angles, &crank_top_x, &crank_top_y, &output_top_x, &output_top_y, &energies})
+    {
+        column->reserve(capacity);
+    }
+}
+
+void CouplerCurve::clear()
+{
+    for (std::vector<double> *column : {&crank_angles, &crank_top_x, &crank_top_y, &output_top_x, &output_top_y, &energies})
+    {
+        column->clear();
+    }
+    this->segment_starts.clear();
+    this->segment_ended = true;
+}
+
+void CouplerCurve::addPose(double crank_angle, const std::tuple<double, double> &crank_top, const std::tuple<double, double> &output_top)
+{
+    if (this->segment_ended)
+    {
+        this->segment_starts.push_back(size());
+        this->segment_ended = false;
+    }
+    this->crank_angles.push_back(crank_angle);
+    this->crank_top_x.push_back(std::get<0>(crank_top));
+    this->crank_top_y.push_back(std::get<1>(crank_top));
+    this->output_top_x.push_back(std::get<0>(output_top));
+    this->output_top_y.push_back(std::get<1>(output_top));
+}
+
+void CouplerCurve::addPose(double crank_angle, const std::tuple<double, double> &crank_top, const std::tuple<double, double> &output_top, double energy)
+{
+    addPose(crank_angle, crank_top, output_top);
+    this->energies.push_back(energy);
+}
+
+void CouplerCurve::endSegment()
+{
+    this->segment_ended = true;
+}
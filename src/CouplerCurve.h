@@ -0,0 +1,122 @@
+#ifndef COUPLERCURVE_H
+#define COUPLERCURVE_H
+
+#include <vector>
+#include <array>
+#include <tuple>
+#include <algorithm>
+#include "FourBarMechanism.h"
+
+// Poses of one mechanism sampled over all of its feasible crank angles: crank angle, coupler head top points and
+// optionally the total energy, as a structure of arrays. Built once by a sweep, then scored against any number
+// of fields (Field::getCurvePressedMask, ...) without moving the mechanism again
+// The poses are split into segments, one per feasible crank angle interval. Consecutive poses of a segment are
+// connected, poses of different segments are not
+class CouplerCurve
+{
+public:
+    CouplerCurve();
+    // Sweeps a copy of the mechanism over its feasible crank angle intervals with a uniform step, the same poses
+    // evaluateCycle visits without adaptive steps. Keeps every decimation-th pose of each interval and always its
+    // last one, so the ends of the path are not cut. Energies are only computed for the kept poses
+    template <typename Scalar>
+    CouplerCurve(BasicFourBarMechanism<Scalar> mechanism, double angle_step, double dt, int decimation = 1, bool store_energies = true);
+
+    void reserve(int capacity);
+    void clear();
+    // Appends a pose to the current segment. Curves that store energies need one for every pose
+    void addPose(double crank_angle, const std::tuple<double, double> &crank_top, const std::tuple<double, double> &output_top);
+    void addPose(double crank_angle, const std::tuple<double, double> &crank_top, const std::tuple<double, double> &output_top, double energy);
+    // The next pose starts a new segment
+    void endSegment();
+
+    int size() const
+    {
+        return this->crank_angles.size();
+    }
+    int getSegmentCount() const
+    {
+        return this->segment_starts.size();
+    }
+    // First pose of the segment and one past its last pose
+    int getSegmentBegin(int segment) const
+    {
+        return this->segment_starts[segment];
+    }
+    int getSegmentEnd(int segment) const
+    {
+        return segment + 1 < getSegmentCount() ? this->segment_starts[segment + 1] : size();
+    }
+    bool hasEnergies() const
+    {
+        return this->energies.size() == this->crank_angles.size();
+    }
+    double getCrankAngle(int index) const
+    {
+        return this->crank_angles[index];
+    }
+    std::tuple<double, double> getCrankTopPosition(int index) const
+    {
+        return std::make_tuple(this->crank_top_x[index], this->crank_top_y[index]);
+    }
+    std::tuple<double, double> getOutputTopPosition(int index) const
+    {
+        return std::make_tuple(this->output_top_x[index], this->output_top_y[index]);
+    }
+    double getEnergy(int index) const
+    {
+        return this->energies[index];
+    }
+
+private:
+    std::vector<double> crank_angles;
+    std::vector<double> crank_top_x;
+    std::vector<double> crank_top_y;
+    std::vector<double> output_top_x;
+    std::vector<double> output_top_y;
+    std::vector<double> energies;
+    // Index of the first pose of every segment
+    std::vector<int> segment_starts;
+    // Whether the next pose starts a new segment
+    bool segment_ended;
+};
+
+template <typename Scalar>
+CouplerCurve::CouplerCurve(BasicFourBarMechanism<Scalar> mechanism, double angle_step, double dt, int decimation, bool store_energies) : CouplerCurve()
+{
+    std::array<AngleInterval, BasicFourBarMechanism<Scalar>::MAX_FEASIBLE_INTERVALS> intervals;
+    int interval_count = mechanism.getFeasibleAngleIntervals(intervals);
+    Scalar step = angle_step;
+    decimation = std::max(decimation, 1);
+    for (int i = 0; i < interval_count; i++)
+    {
+        Scalar start = intervals[i].start;
+        Scalar end = intervals[i].end;
+        long count = 0;
+        mechanism.sweep(start, end, step, Scalar(dt), [&](BasicFourBarMechanism<Scalar> &moved, RotationStatus status)
+                        {
+            // Same test as the loop of sweep, true for the last angle of the interval
+            bool last = !(start + (count + 1) * step <= end);
+            bool kept = count % decimation == 0 || last;
+            count++;
+            // Skips rounding at the ends of the interval
+            if (!kept || status == RotationStatus::Infeasible)
+            {
+                return;
+            }
+            auto [crank_top, output_top] = moved.getCouplerHeadTopPositions();
+            double crank_angle = static_cast<double>(moved.getAngle());
+            std::tuple<double, double> crank_top_position = std::make_tuple(static_cast<double>(std::get<0>(crank_top)), static_cast<double>(std::get<1>(crank_top)));
+            std::tuple<double, double> output_top_position = std::make_tuple(static_cast<double>(std::get<0>(output_top)), static_cast<double>(std::get<1>(output_top)));
+            if (store_energies)
+            {
+                addPose(crank_angle, crank_top_position, output_top_position, static_cast<double>(moved.getTotalEnergy()));
+            }
+            else
+            {
+                addPose(crank_angle, crank_top_position, output_top_position);
+            } });
+        endSegment();
+    }
+}
+#endif
\ No newline at end of file
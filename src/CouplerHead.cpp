@@ -3,6 +3,11 @@
 #include <utility>
 #include <iostream>
 #include "CouplerHead.h"
+#include "Dual.h"
+
+// Unqualified math calls also find the overloads of the Dual scalar type
+using std::pow;
+using std::sqrt;
 
 // Boiler plate code to make tuples add together
 template <typename... T1, typename... T2, std::size_t... I>
@@ -23,10 +28,12 @@ constexpr auto operator+(const std::tuple<T1...> &t1, const std::tuple<T2...> &t
 
 // End of boilerplate code
 
-CouplerHead::CouplerHead() {}
+template <typename Scalar>
+BasicCouplerHead<Scalar>::BasicCouplerHead() {}
 
 // crank_link is the reference
-CouplerHead::CouplerHead(Link &crank_link, Link &output_link, std::tuple<double, double> crank_top_point, std::tuple<double, double> input_top_point, double linear_density)
+template <typename Scalar>
+BasicCouplerHead<Scalar>::BasicCouplerHead(BasicLink<Scalar> &crank_link, BasicLink<Scalar> &output_link, std::tuple<Scalar, Scalar> crank_top_point, std::tuple<Scalar, Scalar> input_top_point, Scalar linear_density)
 {
     this->crank_point = crank_link.getPos2();
     this->output_point = output_link.getPos();
@@ -38,126 +45,141 @@ CouplerHead::CouplerHead(Link &crank_link, Link &output_link, std::tuple<double,
     auto [xct, yct] = this->crank_top_point;
     auto [xot, yot] = this->output_top_point;
 
-    double l_c_ct = std::sqrt(std::pow(std::get<0>(this->crank_point) - std::get<0>(this->crank_top_point), 2) + std::pow(std::get<1>(this->crank_point) - std::get<1>(this->crank_top_point), 2));
-    double l_o_ot = std::sqrt(std::pow(std::get<0>(this->output_point) - std::get<0>(this->output_top_point), 2) + std::pow(std::get<1>(this->output_point) - std::get<1>(this->output_top_point), 2));
-    double l_c_o = std::sqrt(std::pow(std::get<0>(this->crank_point) - std::get<0>(this->output_point), 2) + std::pow(std::get<1>(this->crank_point) - std::get<1>(this->output_point), 2));
-    double l_ct_ot = std::sqrt(std::pow(std::get<0>(this->crank_top_point) - std::get<0>(this->output_top_point), 2) + std::pow(std::get<1>(this->crank_top_point) - std::get<1>(this->output_top_point), 2));
+    Scalar l_c_ct = sqrt(pow(std::get<0>(this->crank_point) - std::get<0>(this->crank_top_point), 2) + pow(std::get<1>(this->crank_point) - std::get<1>(this->crank_top_point), 2));
+    Scalar l_o_ot = sqrt(pow(std::get<0>(this->output_point) - std::get<0>(this->output_top_point), 2) + pow(std::get<1>(this->output_point) - std::get<1>(this->output_top_point), 2));
+    Scalar l_c_o = sqrt(pow(std::get<0>(this->crank_point) - std::get<0>(this->output_point), 2) + pow(std::get<1>(this->crank_point) - std::get<1>(this->output_point), 2));
+    Scalar l_ct_ot = sqrt(pow(std::get<0>(this->crank_top_point) - std::get<0>(this->output_top_point), 2) + pow(std::get<1>(this->crank_top_point) - std::get<1>(this->output_top_point), 2));
 
-    double m_c_ct = l_c_ct * linear_density;
-    double m_o_ot = l_o_ot * linear_density;
-    double m_c_o = l_c_o * linear_density;
-    double m_ct_ot = l_ct_ot * linear_density;
+    Scalar m_c_ct = l_c_ct * linear_density;
+    Scalar m_o_ot = l_o_ot * linear_density;
+    Scalar m_c_o = l_c_o * linear_density;
+    Scalar m_ct_ot = l_ct_ot * linear_density;
 
     this->m = m_c_ct + m_o_ot + m_c_o + m_ct_ot;
 
-    double centroid_c_ct_x = (xc + xct) / 2.0;
-    double centroid_c_ct_y = (yc + yct) / 2.0;
-    double centroid_ct_ot_x = (xct + xot) / 2.0;
-    double centroid_ct_ot_y = (yct + yot) / 2.0;
-    double centroid_ot_o_x = (xot + xo) / 2.0;
-    double centroid_ot_o_y = (yot + yo) / 2.0;
-    double centroid_c_o_x = (xc + xo) / 2.0;
-    double centroid_c_o_y = (yc + yo) / 2.0;
+    Scalar centroid_c_ct_x = (xc + xct) / 2.0;
+    Scalar centroid_c_ct_y = (yc + yct) / 2.0;
+    Scalar centroid_ct_ot_x = (xct + xot) / 2.0;
+    Scalar centroid_ct_ot_y = (yct + yot) / 2.0;
+    Scalar centroid_ot_o_x = (xot + xo) / 2.0;
+    Scalar centroid_ot_o_y = (yot + yo) / 2.0;
+    Scalar centroid_c_o_x = (xc + xo) / 2.0;
+    Scalar centroid_c_o_y = (yc + yo) / 2.0;
 
-    double centroid_x = (centroid_c_ct_x * m_c_ct / 2.0) + (centroid_ct_ot_x * m_ct_ot / 2.0) + (centroid_ot_o_x * m_ot_o / 2.0) + (centroid_c_o_x * m_c_o / 2.0);
-    double centroid_y = (centroid_c_ct_y * m_c_ct / 2.0) + (centroid_ct_ot_y * m_ct_ot / 2.0) + (centroid_ot_o_y * m_ot_o / 2.0) + (centroid_c_o_y * m_c_o / 2.0);
+    Scalar centroid_x = (centroid_c_ct_x * m_c_ct + centroid_ct_ot_x * m_ct_ot + centroid_ot_o_x * m_o_ot + centroid_c_o_x * m_c_o) / this->m;
+    Scalar centroid_y = (centroid_c_ct_y * m_c_ct + centroid_ct_ot_y * m_ct_ot + centroid_ot_o_y * m_o_ot + centroid_c_o_y * m_c_o) / this->m;
 
-    double dist_c_ct = std::sqrt(std::pow(centroid_c_ct_x - centroid_x, 2) + std::pow(centroid_c_ct_y - centroid_y, 2));
-    double dist_ct_ot = std::sqrt(std::pow(centroid_ct_ot_x - centroid_x, 2) + std::pow(centroid_ct_ot_y - centroid_y, 2));
-    double dist_ot_o = std::sqrt(std::pow(centroid_ot_o_x - centroid_x, 2) + std::pow(centroid_ot_o_y - centroid_y, 2));
-    double dist_c_o = std::sqrt(std::pow(centroid_c_o_x - centroid_x, 2) + std::pow(centroid_c_o_y - centroid_y, 2));
+    Scalar dist_c_ct = sqrt(pow(centroid_c_ct_x - centroid_x, 2) + pow(centroid_c_ct_y - centroid_y, 2));
+    Scalar dist_ct_ot = sqrt(pow(centroid_ct_ot_x - centroid_x, 2) + pow(centroid_ct_ot_y - centroid_y, 2));
+    Scalar dist_ot_o = sqrt(pow(centroid_ot_o_x - centroid_x, 2) + pow(centroid_ot_o_y - centroid_y, 2));
+    Scalar dist_c_o = sqrt(pow(centroid_c_o_x - centroid_x, 2) + pow(centroid_c_o_y - centroid_y, 2));
 
     // Calculating the moments of intertia in relation to the centroid of the entire coupler head
     // Using the parallel axis theorem
-    double im_c_ct = m_c_ct * ((std::pow(l_c_ct, 2) / 12.0) + std::pow(dist_c_ct, 2));
-    double im_ct_ot = m_ct_ot * ((std::pow(l_ct_ot, 2) / 12.0) + std::pow(dist_ct_ot, 2));
-    double im_ot_o = m_ot_o * ((std::pow(l_ot_o, 2) / 12.0) + std::pow(dist_ot_o, 2));
-    double im_c_o = m_c_o * ((std::pow(l_c_o, 2) / 12.0) + std::pow(dist_c_o, 2));
+    Scalar im_c_ct = m_c_ct * ((pow(l_c_ct, 2) / 12.0) + pow(dist_c_ct, 2));
+    Scalar im_ct_ot = m_ct_ot * ((pow(l_ct_ot, 2) / 12.0) + pow(dist_ct_ot, 2));
+    Scalar im_ot_o = m_o_ot * ((pow(l_o_ot, 2) / 12.0) + pow(dist_ot_o, 2));
+    Scalar im_c_o = m_c_o * ((pow(l_c_o, 2) / 12.0) + pow(dist_c_o, 2));
 
     this->im = im_c_ct + im_ct_ot + im_ot_o + im_c_o;
+
+    Scalar ux = (xo - xc) / l_c_o;
+    Scalar uy = (yo - yc) / l_c_o;
+    this->crank_top_along = (xct - xc) * ux + (yct - yc) * uy;
+    this->crank_top_across = -(xct - xc) * uy + (yct - yc) * ux;
+    this->output_top_along = (xot - xc) * ux + (yot - yc) * uy;
+    this->output_top_across = -(xot - xc) * uy + (yot - yc) * ux;
+    this->center_of_mass_along = (centroid_x - xc) * ux + (centroid_y - yc) * uy;
+    this->center_of_mass_across = -(centroid_x - xc) * uy + (centroid_y - yc) * ux;
+    setVelocity(0, 0, 0);
 }
 
-void CouplerHead::move(std::tuple<double, double> crank_link_pos, std::tuple<double, double> output_link_pos, double dt)
+template <typename Scalar>
+void BasicCouplerHead<Scalar>::move(std::tuple<Scalar, Scalar> crank_link_pos, std::tuple<Scalar, Scalar> output_link_pos)
 {
-    // Old position
-    auto [xc, yc] = this->crank_point;
-    auto [xo, yo] = this->output_point;
-    auto [xct, yct] = this->crank_top_point;
-    auto [xot, yot] = this->output_top_point;
-    double old_centroid_x = ((xc + xct) * m_c_ct / 2.0) + ((xct + xot) * m_ct_ot / 2.0) + ((xot + xo) * m_ot_o / 2.0) + ((xc + xo) * m_c_o / 2.0);
-    double old_centroid_y = ((yc + yct) * m_c_ct / 2.0) + ((yct + yot) * m_ct_ot / 2.0) + ((yot + yo) * m_ot_o / 2.0) + ((yc + yo) * m_c_o / 2.0);
+    auto [crank_top, output_top] = getTopPositionsAt(crank_link_pos, output_link_pos);
+    this->crank_point = crank_link_pos;
+    this->output_point = output_link_pos;
+    this->crank_top_point = crank_top;
+    this->output_top_point = output_top;
+}
 
-    // New position
+template <typename Scalar>
+std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> BasicCouplerHead<Scalar>::getTopPositionsAt(std::tuple<Scalar, Scalar> crank_link_pos, std::tuple<Scalar, Scalar> output_link_pos) const
+{
     auto [xcn, ycn] = crank_link_pos;
     auto [xon, yon] = output_link_pos;
 
-    double coupler_angle = atan2(yo - yc, xo - xc);
-    double coupler_angle_new = atan2(yon - ycn, xon - xcn);
-
-    // Link between crank and crank_top
-
-    double length_ct = std::sqrt(std::pow(xct - xc, 2) + std::pow(yct - yc, 2));
-    // Angle between the two points relative to the coupler
-    double angle_ct = std::atan2(yct - yc, xct - xc) - coupler_angle;
-    // std::cout << "angle_ct: " << angle_ct << std::endl;
-    double xctn = xcn + length_ct * std::cos(angle_ct + coupler_angle_new);
-    double yctn = ycn + length_ct * std::sin(angle_ct + coupler_angle_new);
-
-    // Link between output and output_top
-
-    double length_ot = std::sqrt(std::pow(xot - xo, 2) + std::pow(yot - yo, 2));
-    // Angle between the two points relative to the coupler
-    double angle_ot = std::atan2(yot - yo, xot - xo) - coupler_angle;
-    // std::cout << "angle_ot: " << angle_ot << "\n";
-    double xotn = xon + length_ot * std::cos(angle_ot + coupler_angle_new);
-    double yotn = yon + length_ot * std::sin(angle_ot + coupler_angle_new);
-
-    // Link between crank_top and input_top is predefined by the constant angles condition
-
-    // TODO: add calculations for speed and angular speed
-    double new_centroid_x = ((xcn + xctn) * m_c_ct / 2.0) + ((xctn + xotn) * m_ct_ot / 2.0) + ((xotn + xon) * m_ot_o / 2.0) + ((xcn + xon) * m_c_o / 2.0);
-    double new_centroid_y = ((ycn + yctn) * m_c_ct / 2.0) + ((yctn + yotn) * m_ct_ot / 2.0) + ((yotn + yon) * m_ot_o / 2.0) + ((ycn + yon) * m_c_o / 2.0);
-    double speed = std::sqrt(std::pow(new_centroid_x - old_centroid_x, 2) + std::pow(new_centroid_y - old_centroid_y, 2)) / dt;
-    double angular_speed = (coupler_angle_new - coupler_angle) / dt;
-    setEnergy(speed, angular_speed, new_centroid_y);
+    // Unit vector along the coupler, the top points keep their coordinates in the coupler frame
+    Scalar coupler_length = sqrt(pow(xon - xcn, 2) + pow(yon - ycn, 2));
+    Scalar ux = (xon - xcn) / coupler_length;
+    Scalar uy = (yon - ycn) / coupler_length;
+    Scalar xctn = xcn + crank_top_along * ux - crank_top_across * uy;
+    Scalar yctn = ycn + crank_top_along * uy + crank_top_across * ux;
+    Scalar xotn = xcn + output_top_along * ux - output_top_across * uy;
+    Scalar yotn = ycn + output_top_along * uy + output_top_across * ux;
+    return std::make_tuple(std::make_tuple(xctn, yctn), std::make_tuple(xotn, yotn));
+}
 
-    this->crank_point = crank_link_pos;
-    this->output_point = output_link_pos;
-    this->crank_top_point = std::make_tuple(xctn, yctn);
-    this->output_top_point = std::make_tuple(xotn, yotn);
+template <typename Scalar>
+void BasicCouplerHead<Scalar>::setVelocity(Scalar crank_point_vx, Scalar crank_point_vy, Scalar angular_speed)
+{
+    auto [xc, yc] = this->crank_point;
+    auto [xo, yo] = this->output_point;
+    Scalar coupler_length = sqrt(pow(xo - xc, 2) + pow(yo - yc, 2));
+    Scalar ux = (xo - xc) / coupler_length;
+    Scalar uy = (yo - yc) / coupler_length;
+    // Center of mass relative to the crank point
+    Scalar rx = center_of_mass_along * ux - center_of_mass_across * uy;
+    Scalar ry = center_of_mass_along * uy + center_of_mass_across * ux;
+    // Rigid body: v = v_crank_point + omega x r
+    Scalar vx = crank_point_vx - angular_speed * ry;
+    Scalar vy = crank_point_vy + angular_speed * rx;
+    setEnergy(sqrt(vx * vx + vy * vy), angular_speed, yc + ry);
 }
 
-std::tuple<double, double> CouplerHead::getCrankPos()
+template <typename Scalar>
+std::tuple<Scalar, Scalar> BasicCouplerHead<Scalar>::getCrankPos()
 {
     return this->crank_point;
 }
 
-std::tuple<double, double> CouplerHead::getOutputPos()
+template <typename Scalar>
+std::tuple<Scalar, Scalar> BasicCouplerHead<Scalar>::getOutputPos()
 {
     return this->output_point;
 }
 
-std::tuple<double, double> CouplerHead::getCrankTopPos() const
+template <typename Scalar>
+std::tuple<Scalar, Scalar> BasicCouplerHead<Scalar>::getCrankTopPos() const
 {
     return this->crank_top_point;
 }
 
-std::tuple<double, double> CouplerHead::getOutputTopPos() const
+template <typename Scalar>
+std::tuple<Scalar, Scalar> BasicCouplerHead<Scalar>::getOutputTopPos() const
 {
     return this->output_top_point;
 }
 
-std::tuple<std::tuple<double, double>, std::tuple<double, double>> CouplerHead::getBaseCouplerPositions()
+template <typename Scalar>
+std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> BasicCouplerHead<Scalar>::getBaseCouplerPositions()
 {
     return std::make_tuple(this->crank_point, this->output_point);
 }
 
-void CouplerHead::setEnergy(double speed, double angular_speed, double y_coord)
+template <typename Scalar>
+void BasicCouplerHead<Scalar>::setEnergy(Scalar speed, Scalar angular_speed, Scalar y_coord)
 {
-    energy = (m * std::pow(speed, 2) / 2.0) + (im * std::pow(angular_speed, 2) / 2.0) + (m * GRAVITY * y_coord);
+    energy = (m * pow(speed, 2) / 2.0) + (im * pow(angular_speed, 2) / 2.0) + (m * GRAVITY * y_coord);
 }
 
-double CouplerHead::getEnergy()
+template <typename Scalar>
+Scalar BasicCouplerHead<Scalar>::getEnergy()
 {
     return this->energy;
 }
+
+template class BasicCouplerHead<double>;
+template class BasicCouplerHead<float>;
+template class BasicCouplerHead<Dual<double>>;
\ No newline at end of file
@@ -3,40 +3,50 @@
 #include <tuple>
 #include "Link.h"
 
-class CouplerHead
+// Generic over the scalar type like BasicLink, CouplerHead is the double version
+template <typename Scalar = double>
+class BasicCouplerHead
 {
 public:
-    CouplerHead();
-    CouplerHead(Link &crank_link, Link &output_link, std::tuple<double, double> crank_top_point, std::tuple<double, double> output_top_point, double linear_density);
+    BasicCouplerHead();
+    BasicCouplerHead(BasicLink<Scalar> &crank_link, BasicLink<Scalar> &output_link, std::tuple<Scalar, Scalar> crank_top_point, std::tuple<Scalar, Scalar> output_top_point, Scalar linear_density);
 
-    void move(std::tuple<double, double> crank_link_pos, std::tuple<double, double> output_link_pos, double dt);
-    std::tuple<double, double> getCrankPos();
-    std::tuple<double, double> getOutputPos();
-    std::tuple<double, double> getCrankTopPos() const;
-    std::tuple<double, double> getOutputTopPos() const;
-    double getEnergy();
-    std::tuple<std::tuple<double, double>, std::tuple<double, double>> getBaseCouplerPositions();
+    // Only moves the head, the energy is set from the velocities with setVelocity
+    void move(std::tuple<Scalar, Scalar> crank_link_pos, std::tuple<Scalar, Scalar> output_link_pos);
+    // Sets the energy from the velocity of the crank point and the angular speed of the head, at the current position
+    void setVelocity(Scalar crank_point_vx, Scalar crank_point_vy, Scalar angular_speed);
+    // Where the crank and output top points would be with the head at these positions, the head is not moved
+    std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> getTopPositionsAt(std::tuple<Scalar, Scalar> crank_link_pos, std::tuple<Scalar, Scalar> output_link_pos) const;
+    std::tuple<Scalar, Scalar> getCrankPos();
+    std::tuple<Scalar, Scalar> getOutputPos();
+    std::tuple<Scalar, Scalar> getCrankTopPos() const;
+    std::tuple<Scalar, Scalar> getOutputTopPos() const;
+    Scalar getEnergy();
+    std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> getBaseCouplerPositions();
 
 private:
-    void setEnergy(double speed, double angular_speed, double y_coord);
-    double m;
-    double im;
-    double energy;
-    double mass_linear_density;
-    double l_c_ct;
-    double m_c_ct;
-    double l_ct_ot;
-    double m_ct_ot;
-    double l_ot_o;
-    double m_ot_o;
-    double l_c_o;
-    double m_c_o;
+    void setEnergy(Scalar speed, Scalar angular_speed, Scalar y_coord);
+    Scalar m;
+    // Moment of inertia around the center of mass
+    Scalar im;
+    Scalar energy;
 
     static constexpr double GRAVITY = 9.80665;
-    std::tuple<double, double> crank_point;
-    std::tuple<double, double> output_point;
+    std::tuple<Scalar, Scalar> crank_point;
+    std::tuple<Scalar, Scalar> output_point;
     // Crank_top is the reference point
-    std::tuple<double, double> crank_top_point;
-    std::tuple<double, double> output_top_point;
+    std::tuple<Scalar, Scalar> crank_top_point;
+    std::tuple<Scalar, Scalar> output_top_point;
+    // The top points in the coupler frame, whose origin is the crank point and whose x axis points to the output point
+    // They are fixed, so moving the head needs no trigonometry
+    Scalar crank_top_along;
+    Scalar crank_top_across;
+    Scalar output_top_along;
+    Scalar output_top_across;
+    // Center of mass in the coupler frame
+    Scalar center_of_mass_along;
+    Scalar center_of_mass_across;
 };
+
+using CouplerHead = BasicCouplerHead<double>;
 #endif
\ No newline at end of file
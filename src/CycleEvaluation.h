@@ -0,0 +1,312 @@
+#ifndef CYCLEEVALUATION_H
+#define CYCLEEVALUATION_H
+#include <cmath>
+#include <array>
+#include <bitset>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "FourBarMechanism.h"
+#include "Field.h"
+
+// How evaluateCycle moves the mechanism and samples its energy
+struct CycleOptions
+{
+    // Crank angle between samples (rad). With adaptive steps only the crank speed angle_step / dt is used
+    double angle_step = 0.001;
+    // Time between samples (s)
+    double dt = 0.01;
+    // Steps follow the speed of the coupler head top points and shrink near the hitboxes, see adaptiveSweep
+    // Off by default: the steps come from a heuristic, and can miss a press that the uniform angle_step sweep finds
+    bool adaptive = false;
+    // With uniform steps, test the moves between consecutive poses against the field instead of the poses themselves,
+    // so coarse steps are less likely to jump over hitboxes. A move records every button pair it crosses
+    // A move whose poses are on different assembly branches is not tested, the pose after it is tested on its own
+    // The moves are still chords timed linearly, so this is not exact: see benchmarkSweptHits for how far it is from
+    // the pose test at 0.001 rad
+    bool swept = false;
+    // Moves over which the coupler turns by more than swept_max_coupler_turn (rad) are split at crank angles in between,
+    // into pieces no shorter than swept_min_step (rad), so the straight moves stay close to the arcs of the top points
+    double swept_max_coupler_turn = 0.01;
+    double swept_min_step = 0.0005;
+    // Skip the sweep if FourBarMechanism::canPressButtonPair proves that no pair of the field can be pressed
+    // The result is the same, except that no steps are counted
+    bool skip_unreachable = true;
+    // Abort before moving the mechanism if FourBarMechanism::canPressButtonPair proves that fewer than min_buttons_pressed
+    // pairs of the field can be pressed, for fitnesses that only need to know whether a mechanism can beat a cutoff
+    int min_buttons_pressed = 0;
+    // The energy is sampled at the crank angles energy_start, energy_start + angle_step, ... before the cycle
+    // Angles where the links can not be assembled or the energy is not finite are left out
+    // The samples are a pass of their own rather than part of the sweep, so their angles stay the same whether the sweep
+    // is adaptive, where its intervals start, or whether the reach check skips it. It costs energy_samples extra moves
+    // As in the original optimize.cpp loop each sample moves on from the one before, and the first from the pose the
+    // mechanism was built in: its crank speed is (energy_start - initial crank angle) / dt, not angle_step / dt
+    int energy_samples = 2;
+    double energy_start = 0;
+};
+
+// What the mechanism did during one turn over its feasible crank angles
+struct CycleResult
+{
+    // Bit i is set if button pair i was pressed. Only the first MAX_TRACKED_BUTTON_PAIRS pairs are tracked
+    std::uint64_t pressed_button_pairs;
+    int buttons_pressed;
+    // Poses visited during the cycle at which the links could be assembled
+    int steps;
+    // Energies that could be sampled, and their mean and standard deviation (J)
+    // The mean and the deviation are 0 when no energy could be sampled
+    int energy_samples;
+    double energy_mean;
+    double energy_deviation;
+    // Set if the cycle stopped because of CycleOptions::min_buttons_pressed. Then buttons_pressed is the number of pairs
+    // that can be pressed, an upper bound, and nothing else is measured
+    bool aborted;
+
+    static constexpr int MAX_TRACKED_BUTTON_PAIRS = 64;
+};
+
+// Sweeps every feasible crank angle interval once, testing the coupler head against the field at every pose
+// and keeping running statistics of the sampled energies (Welford), so nothing is stored and nothing is allocated
+// The mechanism is taken by value, the caller's copy is not moved. The field can be a Field or a StaticField
+template <typename Scalar, typename FieldType>
+CycleResult evaluateCycle(BasicFourBarMechanism<Scalar> mechanism, const FieldType &field, const CycleOptions &options = CycleOptions())
+{
+    CycleResult result = CycleResult{0, 0, 0, 0, 0, 0, false};
+    // Pairs that canPressButtonPair does not rule out, counted until enough are found
+    int reachable = 0;
+    if (options.skip_unreachable || options.min_buttons_pressed > 0)
+    {
+        int needed = std::max(options.min_buttons_pressed, 1);
+        for (const ButtonPair &button_pair : field.getButtonPairs())
+        {
+            if (reachable >= needed)
+            {
+                break;
+            }
+            reachable += mechanism.canPressButtonPair(button_pair);
+        }
+        if (reachable < options.min_buttons_pressed)
+        {
+            result.buttons_pressed = reachable;
+            result.aborted = true;
+            return result;
+        }
+    }
+    Scalar angle_step = options.angle_step;
+    Scalar dt = options.dt;
+
+    // Welford's update keeps the mean and the sum of squared deviations exact enough without storing the samples
+    double squared_deviations = 0;
+    BasicFourBarMechanism<Scalar> energy_probe = mechanism;
+    for (int count = 0; count < options.energy_samples; count++)
+    {
+        if (energy_probe.tryRotate(Scalar(options.energy_start + count * options.angle_step), dt) == RotationStatus::Infeasible)
+        {
+            continue;
+        }
+        double energy = static_cast<double>(energy_probe.getTotalEnergy());
+        if (!std::isfinite(energy))
+        {
+            continue;
+        }
+        result.energy_samples++;
+        double delta = energy - result.energy_mean;
+        result.energy_mean += delta / result.energy_samples;
+        squared_deviations += delta * (energy - result.energy_mean);
+    }
+    if (result.energy_samples > 0)
+    {
+        result.energy_deviation = std::sqrt(squared_deviations / result.energy_samples);
+    }
+
+    bool swept = options.swept && !options.adaptive;
+    auto record = [&](int button_index)
+    {
+        if (button_index != -1 && button_index < CycleResult::MAX_TRACKED_BUTTON_PAIRS)
+        {
+            result.pressed_button_pairs |= std::uint64_t(1) << button_index;
+        }
+    };
+    // Every pair a move crosses is recorded, not only the first one, through a mask that is reused over the cycle
+    std::vector<std::uint64_t> swept_mask;
+    auto record_swept = [&](const std::tuple<double, double> &previous_pos_1, const std::tuple<double, double> &previous_pos_2,
+                            const std::tuple<double, double> &pos_1, const std::tuple<double, double> &pos_2)
+    {
+        field.getSweptPressedMask(previous_pos_1, previous_pos_2, pos_1, pos_2, swept_mask);
+        if (!swept_mask.empty())
+        {
+            result.pressed_button_pairs |= swept_mask[0];
+        }
+    };
+    // Last pose, for the swept test. Not set at the start of an interval or after a change of branch
+    bool has_previous = false;
+    AssemblyBranch previous_branch = AssemblyBranch::Positive;
+    std::tuple<double, double> previous_crank_top;
+    std::tuple<double, double> previous_output_top;
+    double previous_coupler_x = 0;
+    double previous_coupler_y = 0;
+    BasicFourBarMechanism<Scalar> previous_pose = mechanism;
+    auto remember = [&](const BasicFourBarMechanism<Scalar> &pose)
+    {
+        auto [crank_top, output_top] = pose.getCouplerHeadTopPositions();
+        auto [coupler_start, coupler_end] = pose.getCouplerLinkPositions();
+        has_previous = true;
+        previous_branch = pose.getAssemblyBranch();
+        previous_crank_top = std::make_tuple(static_cast<double>(std::get<0>(crank_top)), static_cast<double>(std::get<1>(crank_top)));
+        previous_output_top = std::make_tuple(static_cast<double>(std::get<0>(output_top)), static_cast<double>(std::get<1>(output_top)));
+        previous_coupler_x = static_cast<double>(std::get<0>(coupler_end) - std::get<0>(coupler_start));
+        previous_coupler_y = static_cast<double>(std::get<1>(coupler_end) - std::get<1>(coupler_start));
+        previous_pose = pose;
+    };
+    // Start of the interval being swept, and whether a pose of it was visited yet
+    double interval_start = 0;
+    bool at_interval_start = false;
+    auto visit = [&](BasicFourBarMechanism<Scalar> &moved, RotationStatus status)
+    {
+        // Skips rounding at the ends of the interval
+        if (status == RotationStatus::Infeasible)
+        {
+            has_previous = false;
+            return;
+        }
+        result.steps++;
+        if (swept && at_interval_start)
+        {
+            // The links may not close at the very start of the interval, then the first pose is a whole step in.
+            // The first pose that can be assembled is searched down to swept_min_step, and the move from it is tested
+            double infeasible = interval_start;
+            double feasible = static_cast<double>(moved.getAngle());
+            BasicFourBarMechanism<Scalar> first_pose = moved;
+            while (feasible - infeasible > options.swept_min_step)
+            {
+                double middle = (infeasible + feasible) / 2;
+                BasicFourBarMechanism<Scalar> probe = moved;
+                if (probe.tryRotate(Scalar(middle), dt) == RotationStatus::Moved && probe.getAssemblyBranch() == moved.getAssemblyBranch())
+                {
+                    feasible = middle;
+                    first_pose = probe;
+                }
+                else
+                {
+                    infeasible = middle;
+                }
+            }
+            if (feasible < static_cast<double>(moved.getAngle()))
+            {
+                auto [first_crank_top, first_output_top] = first_pose.getCouplerHeadTopPositions();
+                record(field.getButtonPairPressedIndex(first_crank_top, first_output_top));
+                remember(first_pose);
+            }
+        }
+        at_interval_start = false;
+        auto [moved_crank_top, moved_output_top] = moved.getCouplerHeadTopPositions();
+        std::tuple<double, double> crank_top = std::make_tuple(static_cast<double>(std::get<0>(moved_crank_top)), static_cast<double>(std::get<1>(moved_crank_top)));
+        std::tuple<double, double> output_top = std::make_tuple(static_cast<double>(std::get<0>(moved_output_top)), static_cast<double>(std::get<1>(moved_output_top)));
+        if (!swept)
+        {
+            record(field.getButtonPairPressedIndex(crank_top, output_top));
+            return;
+        }
+        // A coarse step near a dead point can land on the other branch, the straight move between the two poses
+        // would cross hitboxes the coupler head never visits
+        AssemblyBranch branch = moved.getAssemblyBranch();
+        auto [coupler_start, coupler_end] = moved.getCouplerLinkPositions();
+        double coupler_x = static_cast<double>(std::get<0>(coupler_end) - std::get<0>(coupler_start));
+        double coupler_y = static_cast<double>(std::get<1>(coupler_end) - std::get<1>(coupler_start));
+        if (has_previous && branch == previous_branch)
+        {
+            // The top points turn with the coupler around the crank pin, the more it turns the further their arcs stray
+            // from the straight moves. Such moves are split at crank angles in between, down to swept_min_step
+            double coupler_turn = std::abs(std::atan2(previous_coupler_x * coupler_y - previous_coupler_y * coupler_x, previous_coupler_x * coupler_x + previous_coupler_y * coupler_y));
+            double previous_angle = static_cast<double>(previous_pose.getAngle());
+            double crank_turn = static_cast<double>(moved.getAngle()) - previous_angle;
+            int pieces = (int)std::min(std::ceil(coupler_turn / options.swept_max_coupler_turn), std::max(std::floor(std::abs(crank_turn) / options.swept_min_step), 1.0));
+            for (int piece = 1; piece < pieces; piece++)
+            {
+                if (previous_pose.tryRotate(Scalar(previous_angle + crank_turn * piece / pieces), dt) != RotationStatus::Moved || previous_pose.getAssemblyBranch() != branch)
+                {
+                    // The rest of the move is not tested, only the pose it ends at
+                    has_previous = false;
+                    break;
+                }
+                auto [piece_crank_top, piece_output_top] = previous_pose.getCouplerHeadTopPositions();
+                std::tuple<double, double> piece_crank = std::make_tuple(static_cast<double>(std::get<0>(piece_crank_top)), static_cast<double>(std::get<1>(piece_crank_top)));
+                std::tuple<double, double> piece_output = std::make_tuple(static_cast<double>(std::get<0>(piece_output_top)), static_cast<double>(std::get<1>(piece_output_top)));
+                record_swept(previous_crank_top, previous_output_top, piece_crank, piece_output);
+                previous_crank_top = piece_crank;
+                previous_output_top = piece_output;
+            }
+        }
+        else
+        {
+            has_previous = false;
+        }
+        if (has_previous)
+        {
+            record_swept(previous_crank_top, previous_output_top, crank_top, output_top);
+        }
+        else
+        {
+            record(field.getButtonPairPressedIndex(crank_top, output_top));
+        }
+        remember(moved);
+    };
+    std::array<AngleInterval, BasicFourBarMechanism<Scalar>::MAX_FEASIBLE_INTERVALS> intervals;
+    int interval_count = mechanism.getFeasibleAngleIntervals(intervals);
+    if (options.skip_unreachable && reachable == 0)
+    {
+        interval_count = 0;
+    }
+    for (int i = 0; i < interval_count; i++)
+    {
+        has_previous = false;
+        interval_start = intervals[i].start;
+        at_interval_start = true;
+        if (options.adaptive)
+        {
+            mechanism.adaptiveSweep(Scalar(intervals[i].start), Scalar(intervals[i].end), field, angle_step / dt, visit);
+        }
+        else
+        {
+            mechanism.sweep(Scalar(intervals[i].start), Scalar(intervals[i].end), angle_step, dt, visit);
+            // The last step stops short of the end of the interval by up to angle_step, the swept test covers the rest.
+            // As at the start the links may not close at the very end, then the last pose that can be assembled is
+            // searched down to swept_min_step. A copy is moved, so the next interval starts from the same pose as without
+            if (swept && has_previous && static_cast<double>(mechanism.getAngle()) < intervals[i].end)
+            {
+                double feasible = static_cast<double>(mechanism.getAngle());
+                BasicFourBarMechanism<Scalar> last_pose = mechanism;
+                if (last_pose.tryRotate(Scalar(intervals[i].end), dt) == RotationStatus::Moved && last_pose.getAssemblyBranch() == mechanism.getAssemblyBranch())
+                {
+                    feasible = intervals[i].end;
+                }
+                else
+                {
+                    last_pose = mechanism;
+                    double infeasible = intervals[i].end;
+                    while (infeasible - feasible > options.swept_min_step)
+                    {
+                        double middle = (infeasible + feasible) / 2;
+                        BasicFourBarMechanism<Scalar> probe = mechanism;
+                        if (probe.tryRotate(Scalar(middle), dt) == RotationStatus::Moved && probe.getAssemblyBranch() == mechanism.getAssemblyBranch())
+                        {
+                            feasible = middle;
+                            last_pose = probe;
+                        }
+                        else
+                        {
+                            infeasible = middle;
+                        }
+                    }
+                }
+                if (feasible > static_cast<double>(mechanism.getAngle()))
+                {
+                    visit(last_pose, RotationStatus::Moved);
+                }
+            }
+        }
+    }
+    result.buttons_pressed = std::bitset<CycleResult::MAX_TRACKED_BUTTON_PAIRS>(result.pressed_button_pairs).count();
+    return result;
+}
+#endif
\ No newline at end of file
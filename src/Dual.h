@@ -0,0 +1,66 @@
+#ifndef DUAL_H
+#define DUAL_H
+#include <cmath>
+#include <ostream>
+
+// Forward mode automatic differentiation number: value + derivative * e, with e * e = 0
+// Seeding one input with a derivative of 1 gives the derivative of every result with respect to that input
+// The math functions are found by argument dependent lookup, generic code calls them unqualified after using std::sqrt etc.
+template <typename T>
+struct Dual
+{
+    T value;
+    T derivative;
+
+    constexpr Dual() : value(0), derivative(0) {}
+    // Constants have no derivative
+    constexpr Dual(T value) : value(value), derivative(0) {}
+    constexpr Dual(T value, T derivative) : value(value), derivative(derivative) {}
+    explicit constexpr operator T() const { return value; }
+
+    Dual &operator+=(const Dual &other) { return *this = *this + other; }
+    Dual &operator-=(const Dual &other) { return *this = *this - other; }
+    Dual &operator*=(const Dual &other) { return *this = *this * other; }
+    Dual &operator/=(const Dual &other) { return *this = *this / other; }
+
+    friend constexpr Dual operator-(const Dual &a) { return Dual(-a.value, -a.derivative); }
+    friend constexpr Dual operator+(const Dual &a, const Dual &b) { return Dual(a.value + b.value, a.derivative + b.derivative); }
+    friend constexpr Dual operator-(const Dual &a, const Dual &b) { return Dual(a.value - b.value, a.derivative - b.derivative); }
+    friend constexpr Dual operator*(const Dual &a, const Dual &b) { return Dual(a.value * b.value, a.derivative * b.value + a.value * b.derivative); }
+    friend constexpr Dual operator/(const Dual &a, const Dual &b)
+    {
+        return Dual(a.value / b.value, (a.derivative * b.value - a.value * b.derivative) / (b.value * b.value));
+    }
+
+    // Comparisons only look at the value
+    friend constexpr bool operator<(const Dual &a, const Dual &b) { return a.value < b.value; }
+    friend constexpr bool operator>(const Dual &a, const Dual &b) { return a.value > b.value; }
+    friend constexpr bool operator<=(const Dual &a, const Dual &b) { return a.value <= b.value; }
+    friend constexpr bool operator>=(const Dual &a, const Dual &b) { return a.value >= b.value; }
+    friend constexpr bool operator==(const Dual &a, const Dual &b) { return a.value == b.value; }
+    friend constexpr bool operator!=(const Dual &a, const Dual &b) { return a.value != b.value; }
+
+    friend Dual sqrt(const Dual &a)
+    {
+        T root = std::sqrt(a.value);
+        return Dual(root, a.derivative / (2 * root));
+    }
+    friend Dual pow(const Dual &a, T exponent)
+    {
+        return Dual(std::pow(a.value, exponent), exponent * std::pow(a.value, exponent - 1) * a.derivative);
+    }
+    friend Dual sin(const Dual &a) { return Dual(std::sin(a.value), std::cos(a.value) * a.derivative); }
+    friend Dual cos(const Dual &a) { return Dual(std::cos(a.value), -std::sin(a.value) * a.derivative); }
+    friend Dual acos(const Dual &a) { return Dual(std::acos(a.value), -a.derivative / std::sqrt(1 - a.value * a.value)); }
+    friend Dual atan2(const Dual &y, const Dual &x)
+    {
+        T norm = x.value * x.value + y.value * y.value;
+        return Dual(std::atan2(y.value, x.value), (x.value * y.derivative - y.value * x.derivative) / norm);
+    }
+    friend Dual hypot(const Dual &x, const Dual &y) { return sqrt(x * x + y * y); }
+    friend Dual abs(const Dual &a) { return a.value < 0 ? -a : a; }
+    friend bool isnan(const Dual &a) { return std::isnan(a.value) || std::isnan(a.derivative); }
+
+    friend std::ostream &operator<<(std::ostream &os, const Dual &a) { return os << a.value; }
+};
+#endif
\ No newline at end of file
@@ -1,35 +1,156 @@
 #include "Field.h"
+#include "CouplerCurve.h"
 #include <cmath>
+#include <limits>
+#include <algorithm>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
 
-Field::Field() {}
+Field::Field()
+{
+    this->smallest_hitbox_radius = std::numeric_limits<double>::infinity();
+    this->has_grid = false;
+    this->grid_built_size = 0;
+}
 
-Field::Field(std::initializer_list<ButtonPair> button_pairs)
+Field::Field(std::initializer_list<ButtonPair> button_pairs) : Field()
 {
     for (ButtonPair button_pair : button_pairs)
     {
-        this->ButtonPairs.push_back(button_pair);
+        storeButtonPair(button_pair);
     }
+    buildGrid();
 }
 
 void Field::addButtonPair(ButtonPair button_pair)
+{
+    storeButtonPair(button_pair);
+    addToGrid(this->ButtonPairs.size() - 1);
+}
+
+void Field::storeButtonPair(const ButtonPair &button_pair)
 {
     this->ButtonPairs.push_back(button_pair);
+    this->hitbox_x1.push_back(button_pair.x1);
+    this->hitbox_y1.push_back(button_pair.y1);
+    this->hitbox_r1.push_back(button_pair.r1);
+    this->hitbox_x2.push_back(button_pair.x2);
+    this->hitbox_y2.push_back(button_pair.y2);
+    this->hitbox_r2.push_back(button_pair.r2);
+    this->smallest_hitbox_radius = std::min(this->smallest_hitbox_radius, std::min(button_pair.r1, button_pair.r2));
 }
 
-std::vector<ButtonPair> Field::getButtonPairs()
+const std::vector<ButtonPair> &Field::getButtonPairs() const
 {
     return this->ButtonPairs;
 }
 
+int Field::getButtonPairCount() const
+{
+    return this->ButtonPairs.size();
+}
+
+double Field::getSmallestHitboxRadius() const
+{
+    return this->smallest_hitbox_radius;
+}
+
+double Field::getButtonPairDistance(double x1, double y1, double x2, double y2, int index) const
+{
+    // A pair is pressed when both points are inside their boxes, so the farther one decides
+    double distance_1 = std::max(std::abs(x1 - this->hitbox_x1[index]), std::abs(y1 - this->hitbox_y1[index])) - this->hitbox_r1[index];
+    double distance_2 = std::max(std::abs(x2 - this->hitbox_x2[index]), std::abs(y2 - this->hitbox_y2[index])) - this->hitbox_r2[index];
+    return std::max(distance_1, distance_2);
+}
+
+double Field::getClearance(std::tuple<double, double> mech_pos_1, std::tuple<double, double> mech_pos_2) const
+{
+    auto [x1, y1] = mech_pos_1;
+    auto [x2, y2] = mech_pos_2;
+    double clearance = std::numeric_limits<double>::infinity();
+    if (!this->has_grid)
+    {
+        int size = this->ButtonPairs.size();
+        for (int i = 0; i < size; i++)
+        {
+            double distance = getButtonPairDistance(x1, y1, x2, y2, i);
+            if (distance >= 0)
+            {
+                clearance = std::min(clearance, distance);
+            }
+        }
+        return clearance;
+    }
+
+    // Rings of cells around the cell of the first point. The first hitbox of a pair that touches none of the first k rings
+    // is more than k cells away from the point, so the search stops once the closest pair found is nearer than that
+    int column = getGridColumn(x1);
+    int row = getGridRow(y1);
+    int first_ring = std::max(std::max(-column, column - (this->grid_columns - 1)), std::max(-row, row - (this->grid_rows - 1)));
+    int last_ring = std::max(std::max(std::abs(column), std::abs(column - (this->grid_columns - 1))), std::max(std::abs(row), std::abs(row - (this->grid_rows - 1))));
+    for (int ring = std::max(first_ring, 0); ring <= last_ring; ring++)
+    {
+        int first_row = std::max(row - ring, 0);
+        int last_row = std::min(row + ring, this->grid_rows - 1);
+        for (int cell_row = first_row; cell_row <= last_row; cell_row++)
+        {
+            // Whole rows at the top and bottom of the ring, only the two ends in between
+            bool full_row = std::abs(cell_row - row) == ring;
+            int step = full_row ? 1 : std::max(2 * ring, 1);
+            for (int cell_column = column - ring; cell_column <= column + ring; cell_column += step)
+            {
+                if (cell_column < 0 || cell_column >= this->grid_columns)
+                {
+                    continue;
+                }
+                for (int index : this->grid_cells[cell_row * this->grid_columns + cell_column])
+                {
+                    double distance = getButtonPairDistance(x1, y1, x2, y2, index);
+                    if (distance >= 0)
+                    {
+                        clearance = std::min(clearance, distance);
+                    }
+                }
+            }
+        }
+        if (clearance <= ring * this->grid_cell_size)
+        {
+            break;
+        }
+    }
+    return clearance;
+}
+
 // Returns the index of the first button pair that is being pressed by the coupler head given by the positions
 // Returns -1 if no button is being pressed
 // USES A SQUARE HIT BOX TO INCREASE PERFORMANCE
-int Field::getButtonPairPressedIndex(std::tuple<double, double> mech_pos_1, std::tuple<double, double> mech_pos_2)
+int Field::getButtonPairPressedIndex(std::tuple<double, double> mech_pos_1, std::tuple<double, double> mech_pos_2) const
 {
+    auto [x1, y1] = mech_pos_1;
+    auto [x2, y2] = mech_pos_2;
+    if (this->has_grid)
+    {
+        // A pressed pair has the first point inside its first hitbox, so it is listed in the cell of the first point
+        int column = getGridColumn(x1);
+        int row = getGridRow(y1);
+        if (column < 0 || column >= this->grid_columns || row < 0 || row >= this->grid_rows)
+        {
+            return -1;
+        }
+        for (int index : this->grid_cells[row * this->grid_columns + column])
+        {
+            if (isButtonPairPressed(x1, y1, x2, y2, index))
+            {
+                return index;
+            }
+        }
+        return -1;
+    }
     int size = this->ButtonPairs.size();
     for (int i = 0; i < size; i++)
     {
-        if (isButtonPairPressed(mech_pos_1, mech_pos_2, this->ButtonPairs[i]))
+        if (isButtonPairPressed(x1, y1, x2, y2, i))
         {
             return i;
         }
@@ -37,20 +158,363 @@ int Field::getButtonPairPressedIndex(std::tuple<double, double> mech_pos_1, std:
     return -1;
 }
 
+bool Field::wasButtonPairSwept(double x1, double y1, double dx1, double dy1, double x2, double y2, double dx2, double dy2, int index) const
+{
+    // The hitboxes are open squares, so the pair is pressed during an open interval of the move
+    double low = 0;
+    double high = 1;
+    clipToHitbox(x1, dx1, this->hitbox_x1[index], this->hitbox_r1[index], low, high);
+    clipToHitbox(y1, dy1, this->hitbox_y1[index], this->hitbox_r1[index], low, high);
+    clipToHitbox(x2, dx2, this->hitbox_x2[index], this->hitbox_r2[index], low, high);
+    clipToHitbox(y2, dy2, this->hitbox_y2[index], this->hitbox_r2[index], low, high);
+    return low < high;
+}
+
+template <typename Visitor>
+void Field::forEachSweptCandidate(double x1, double y1, double dx1, double dy1, Visitor visitor) const
+{
+    if (!this->has_grid)
+    {
+        int size = this->ButtonPairs.size();
+        for (int i = 0; i < size; i++)
+        {
+            visitor(i);
+        }
+        return;
+    }
+    // The first hitbox of a pair the first point went through overlaps a cell of the bounding box of the move
+    int first_column = std::max(getGridColumn(std::min(x1, x1 + dx1)), 0);
+    int last_column = std::min(getGridColumn(std::max(x1, x1 + dx1)), this->grid_columns - 1);
+    int first_row = std::max(getGridRow(std::min(y1, y1 + dy1)), 0);
+    int last_row = std::min(getGridRow(std::max(y1, y1 + dy1)), this->grid_rows - 1);
+    for (int row = first_row; row <= last_row; row++)
+    {
+        for (int column = first_column; column <= last_column; column++)
+        {
+            for (int index : this->grid_cells[row * this->grid_columns + column])
+            {
+                visitor(index);
+            }
+        }
+    }
+}
+
+int Field::getButtonPairSweptIndex(std::tuple<double, double> previous_pos_1, std::tuple<double, double> previous_pos_2,
+                                   std::tuple<double, double> mech_pos_1, std::tuple<double, double> mech_pos_2) const
+{
+    auto [x1, y1] = previous_pos_1;
+    auto [x2, y2] = previous_pos_2;
+    double dx1 = std::get<0>(mech_pos_1) - x1;
+    double dy1 = std::get<1>(mech_pos_1) - y1;
+    double dx2 = std::get<0>(mech_pos_2) - x2;
+    double dy2 = std::get<1>(mech_pos_2) - y2;
+    int first_index = -1;
+    forEachSweptCandidate(x1, y1, dx1, dy1, [&](int index)
+                          {
+        if ((first_index == -1 || index < first_index) && wasButtonPairSwept(x1, y1, dx1, dy1, x2, y2, dx2, dy2, index))
+        {
+            first_index = index;
+        } });
+    return first_index;
+}
+
+void Field::getSweptPressedMask(std::tuple<double, double> previous_pos_1, std::tuple<double, double> previous_pos_2,
+                                std::tuple<double, double> mech_pos_1, std::tuple<double, double> mech_pos_2, std::vector<std::uint64_t> &mask) const
+{
+    auto [x1, y1] = previous_pos_1;
+    auto [x2, y2] = previous_pos_2;
+    double dx1 = std::get<0>(mech_pos_1) - x1;
+    double dy1 = std::get<1>(mech_pos_1) - y1;
+    double dx2 = std::get<0>(mech_pos_2) - x2;
+    double dy2 = std::get<1>(mech_pos_2) - y2;
+    mask.assign(getPressedMaskWords(), 0);
+    orSweptBits(x1, y1, x2, y2, dx1, dy1, dx2, dy2, mask.data());
+}
+
+void Field::orSweptBits(double x1, double y1, double x2, double y2, double dx1, double dy1, double dx2, double dy2, std::uint64_t *mask) const
+{
+    forEachSweptCandidate(x1, y1, dx1, dy1, [&](int index)
+                          {
+        if (wasButtonPairSwept(x1, y1, dx1, dy1, x2, y2, dx2, dy2, index))
+        {
+            mask[index / 64] |= std::uint64_t(1) << (index % 64);
+        } });
+}
+
+void Field::getCurvePressedMask(const CouplerCurve &curve, std::vector<std::uint64_t> &mask) const
+{
+    mask.assign(getPressedMaskWords(), 0);
+    int size = curve.size();
+    if (this->has_grid)
+    {
+        for (int i = 0; i < size; i++)
+        {
+            auto [x1, y1] = curve.getCrankTopPosition(i);
+            auto [x2, y2] = curve.getOutputTopPosition(i);
+            orPressedBits(x1, y1, x2, y2, mask.data());
+        }
+        return;
+    }
+    // Few pairs: one pass over the curve per pair, which stops at the first pose that presses it
+    int count = this->ButtonPairs.size();
+    for (int index = 0; index < count; index++)
+    {
+        for (int i = 0; i < size; i++)
+        {
+            auto [x1, y1] = curve.getCrankTopPosition(i);
+            auto [x2, y2] = curve.getOutputTopPosition(i);
+            if (isButtonPairPressed(x1, y1, x2, y2, index))
+            {
+                mask[index / 64] |= std::uint64_t(1) << (index % 64);
+                break;
+            }
+        }
+    }
+}
+
+void Field::getCurveSweptPressedMask(const CouplerCurve &curve, std::vector<std::uint64_t> &mask) const
+{
+    mask.assign(getPressedMaskWords(), 0);
+    if (this->has_grid)
+    {
+        for (int segment = 0; segment < curve.getSegmentCount(); segment++)
+        {
+            int begin = curve.getSegmentBegin(segment);
+            int end = curve.getSegmentEnd(segment);
+            auto [x1, y1] = curve.getCrankTopPosition(begin);
+            auto [x2, y2] = curve.getOutputTopPosition(begin);
+            orPressedBits(x1, y1, x2, y2, mask.data());
+            for (int i = begin + 1; i < end; i++)
+            {
+                auto [next_x1, next_y1] = curve.getCrankTopPosition(i);
+                auto [next_x2, next_y2] = curve.getOutputTopPosition(i);
+                orSweptBits(x1, y1, x2, y2, next_x1 - x1, next_y1 - y1, next_x2 - x2, next_y2 - y2, mask.data());
+                x1 = next_x1;
+                y1 = next_y1;
+                x2 = next_x2;
+                y2 = next_y2;
+            }
+        }
+        return;
+    }
+    // Few pairs: one pass over the curve per pair, as in getCurvePressedMask
+    int count = this->ButtonPairs.size();
+    for (int index = 0; index < count; index++)
+    {
+        bool pressed = false;
+        for (int segment = 0; segment < curve.getSegmentCount() && !pressed; segment++)
+        {
+            int begin = curve.getSegmentBegin(segment);
+            int end = curve.getSegmentEnd(segment);
+            auto [x1, y1] = curve.getCrankTopPosition(begin);
+            auto [x2, y2] = curve.getOutputTopPosition(begin);
+            pressed = isButtonPairPressed(x1, y1, x2, y2, index);
+            for (int i = begin + 1; i < end && !pressed; i++)
+            {
+                auto [next_x1, next_y1] = curve.getCrankTopPosition(i);
+                auto [next_x2, next_y2] = curve.getOutputTopPosition(i);
+                pressed = wasButtonPairSwept(x1, y1, next_x1 - x1, next_y1 - y1, x2, y2, next_x2 - x2, next_y2 - y2, index);
+                x1 = next_x1;
+                y1 = next_y1;
+                x2 = next_x2;
+                y2 = next_y2;
+            }
+        }
+        mask[index / 64] |= std::uint64_t(pressed) << (index % 64);
+    }
+}
+
+double Field::getCurveClearance(const CouplerCurve &curve) const
+{
+    double clearance = std::numeric_limits<double>::infinity();
+    int size = curve.size();
+    for (int i = 0; i < size; i++)
+    {
+        clearance = std::min(clearance, getClearance(curve.getCrankTopPosition(i), curve.getOutputTopPosition(i)));
+    }
+    return clearance;
+}
+
+void Field::buildGrid()
+{
+    int size = this->ButtonPairs.size();
+    this->grid_cells.clear();
+    this->has_grid = size >= GRID_MIN_PAIRS;
+    if (!this->has_grid)
+    {
+        return;
+    }
+    double min_x = std::numeric_limits<double>::infinity();
+    double min_y = std::numeric_limits<double>::infinity();
+    double max_x = -std::numeric_limits<double>::infinity();
+    double max_y = -std::numeric_limits<double>::infinity();
+    double largest_radius = 0;
+    for (const ButtonPair &button_pair : this->ButtonPairs)
+    {
+        min_x = std::min(min_x, button_pair.x1 - button_pair.r1);
+        min_y = std::min(min_y, button_pair.y1 - button_pair.r1);
+        max_x = std::max(max_x, button_pair.x1 + button_pair.r1);
+        max_y = std::max(max_y, button_pair.y1 + button_pair.r1);
+        largest_radius = std::max(largest_radius, button_pair.r1);
+    }
+    // Degenerate layouts, all the hitboxes on one point or one line, still get a grid of some size
+    double width = std::max(max_x - min_x, 1e-9);
+    double height = std::max(max_y - min_y, 1e-9);
+    this->grid_x = min_x - GRID_MARGIN * width;
+    this->grid_y = min_y - GRID_MARGIN * height;
+    width *= 1 + 2 * GRID_MARGIN;
+    height *= 1 + 2 * GRID_MARGIN;
+    // About one pair per cell, and a hitbox overlaps at most 4 cells
+    this->grid_cell_size = std::max(2 * largest_radius, std::sqrt(width * height / size));
+    this->grid_columns = std::max(1, static_cast<int>(std::ceil(width / this->grid_cell_size)));
+    this->grid_rows = std::max(1, static_cast<int>(std::ceil(height / this->grid_cell_size)));
+    this->grid_cells.resize(this->grid_columns * this->grid_rows);
+    this->grid_built_size = size;
+    for (int i = 0; i < size; i++)
+    {
+        insertIntoGrid(i);
+    }
+}
+
+void Field::addToGrid(int index)
+{
+    const ButtonPair &button_pair = this->ButtonPairs[index];
+    bool fits = this->has_grid && button_pair.x1 - button_pair.r1 >= this->grid_x && button_pair.y1 - button_pair.r1 >= this->grid_y &&
+                button_pair.x1 + button_pair.r1 <= this->grid_x + this->grid_columns * this->grid_cell_size &&
+                button_pair.y1 + button_pair.r1 <= this->grid_y + this->grid_rows * this->grid_cell_size;
+    // Rebuilding when the number of pairs doubles keeps about one pair per cell, and costs O(1) per pair on average
+    if (!fits || index + 1 >= 2 * this->grid_built_size)
+    {
+        buildGrid();
+        return;
+    }
+    insertIntoGrid(index);
+}
+
+void Field::insertIntoGrid(int index)
+{
+    const ButtonPair &button_pair = this->ButtonPairs[index];
+    int first_column = std::max(getGridColumn(button_pair.x1 - button_pair.r1), 0);
+    int last_column = std::min(getGridColumn(button_pair.x1 + button_pair.r1), this->grid_columns - 1);
+    int first_row = std::max(getGridRow(button_pair.y1 - button_pair.r1), 0);
+    int last_row = std::min(getGridRow(button_pair.y1 + button_pair.r1), this->grid_rows - 1);
+    for (int row = first_row; row <= last_row; row++)
+    {
+        for (int column = first_column; column <= last_column; column++)
+        {
+            this->grid_cells[row * this->grid_columns + column].push_back(index);
+        }
+    }
+}
+
+int Field::getGridColumn(double x) const
+{
+    return static_cast<int>(std::floor((x - this->grid_x) / this->grid_cell_size));
+}
+
+int Field::getGridRow(double y) const
+{
+    return static_cast<int>(std::floor((y - this->grid_y) / this->grid_cell_size));
+}
+
 // USES A SQUARE HIT BOX TO INCREASE PERFORMANCE
-bool Field::isButtonPairPressed(std::tuple<double, double> mech_pos_1, std::tuple<double, double> mech_pos_2, ButtonPair button_pair)
+bool Field::isButtonPairPressed(double x1, double y1, double x2, double y2, int index) const
+{
+    return std::abs(x1 - this->hitbox_x1[index]) < this->hitbox_r1[index] && std::abs(y1 - this->hitbox_y1[index]) < this->hitbox_r1[index] &&
+           std::abs(x2 - this->hitbox_x2[index]) < this->hitbox_r2[index] && std::abs(y2 - this->hitbox_y2[index]) < this->hitbox_r2[index];
+}
+
+void Field::getPressedMask(std::tuple<double, double> mech_pos_1, std::tuple<double, double> mech_pos_2, std::vector<std::uint64_t> &mask) const
 {
     auto [x1, y1] = mech_pos_1;
     auto [x2, y2] = mech_pos_2;
-    double x1b = button_pair.x1;
-    double y1b = button_pair.y1;
-    double r1b = button_pair.r1;
-    double x2b = button_pair.x2;
-    double y2b = button_pair.y2;
-    double r2b = button_pair.r2;
-    if (std::abs(x1 - x1b) < r1b && std::abs(y1 - y1b) < r1b && std::abs(x2 - x2b) < r2b && std::abs(y2 - y2b) < r2b)
-    {
-        return true;
-    }
-    return false;
-}
\ No newline at end of file
+    mask.assign(getPressedMaskWords(), 0);
+    orPressedBits(x1, y1, x2, y2, mask.data());
+}
+
+void Field::orPressedBits(double x1, double y1, double x2, double y2, std::uint64_t *mask) const
+{
+    if (this->has_grid)
+    {
+        int column = getGridColumn(x1);
+        int row = getGridRow(y1);
+        if (column < 0 || column >= this->grid_columns || row < 0 || row >= this->grid_rows)
+        {
+            return;
+        }
+        for (int index : this->grid_cells[row * this->grid_columns + column])
+        {
+            if (isButtonPairPressed(x1, y1, x2, y2, index))
+            {
+                mask[index / 64] |= std::uint64_t(1) << (index % 64);
+            }
+        }
+        return;
+    }
+    int count = this->ButtonPairs.size();
+    int begin = 0;
+#if defined(__AVX512F__)
+    int vector_end = count - count % 8;
+    setPressedBitsAvx512(x1, y1, x2, y2, 0, vector_end, mask);
+    begin = vector_end;
+#elif defined(__AVX2__)
+    int vector_end = count - count % 4;
+    setPressedBitsAvx2(x1, y1, x2, y2, 0, vector_end, mask);
+    begin = vector_end;
+#endif
+    setPressedBits(x1, y1, x2, y2, begin, count, mask);
+}
+
+int Field::getPressedMaskWords() const
+{
+    return (this->ButtonPairs.size() + 63) / 64;
+}
+
+void Field::setPressedBits(double x1, double y1, double x2, double y2, int begin, int end, std::uint64_t *mask) const
+{
+    for (int i = begin; i < end; i++)
+    {
+        mask[i / 64] |= std::uint64_t(isButtonPairPressed(x1, y1, x2, y2, i)) << (i % 64);
+    }
+}
+
+#if defined(__AVX512F__)
+void Field::setPressedBitsAvx512(double x1, double y1, double x2, double y2, int begin, int end, std::uint64_t *mask) const
+{
+    const __m512d x1_v = _mm512_set1_pd(x1);
+    const __m512d y1_v = _mm512_set1_pd(y1);
+    const __m512d x2_v = _mm512_set1_pd(x2);
+    const __m512d y2_v = _mm512_set1_pd(y2);
+    for (int i = begin; i < end; i += 8)
+    {
+        __m512d r1 = _mm512_loadu_pd(&this->hitbox_r1[i]);
+        __m512d r2 = _mm512_loadu_pd(&this->hitbox_r2[i]);
+        __mmask8 pressed = _mm512_cmp_pd_mask(_mm512_abs_pd(_mm512_sub_pd(x1_v, _mm512_loadu_pd(&this->hitbox_x1[i]))), r1, _CMP_LT_OQ) &
+                           _mm512_cmp_pd_mask(_mm512_abs_pd(_mm512_sub_pd(y1_v, _mm512_loadu_pd(&this->hitbox_y1[i]))), r1, _CMP_LT_OQ) &
+                           _mm512_cmp_pd_mask(_mm512_abs_pd(_mm512_sub_pd(x2_v, _mm512_loadu_pd(&this->hitbox_x2[i]))), r2, _CMP_LT_OQ) &
+                           _mm512_cmp_pd_mask(_mm512_abs_pd(_mm512_sub_pd(y2_v, _mm512_loadu_pd(&this->hitbox_y2[i]))), r2, _CMP_LT_OQ);
+        // i is a multiple of 8, so the 8 bits never straddle two words
+        mask[i / 64] |= std::uint64_t(pressed) << (i % 64);
+    }
+}
+#elif defined(__AVX2__)
+void Field::setPressedBitsAvx2(double x1, double y1, double x2, double y2, int begin, int end, std::uint64_t *mask) const
+{
+    const __m256d x1_v = _mm256_set1_pd(x1);
+    const __m256d y1_v = _mm256_set1_pd(y1);
+    const __m256d x2_v = _mm256_set1_pd(x2);
+    const __m256d y2_v = _mm256_set1_pd(y2);
+    const __m256d sign_bit = _mm256_set1_pd(-0.0);
+    for (int i = begin; i < end; i += 4)
+    {
+        __m256d r1 = _mm256_loadu_pd(&this->hitbox_r1[i]);
+        __m256d r2 = _mm256_loadu_pd(&this->hitbox_r2[i]);
+        __m256d pressed = _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(_mm256_andnot_pd(sign_bit, _mm256_sub_pd(x1_v, _mm256_loadu_pd(&this->hitbox_x1[i]))), r1, _CMP_LT_OQ),
+                                                      _mm256_cmp_pd(_mm256_andnot_pd(sign_bit, _mm256_sub_pd(y1_v, _mm256_loadu_pd(&this->hitbox_y1[i]))), r1, _CMP_LT_OQ)),
+                                        _mm256_and_pd(_mm256_cmp_pd(_mm256_andnot_pd(sign_bit, _mm256_sub_pd(x2_v, _mm256_loadu_pd(&this->hitbox_x2[i]))), r2, _CMP_LT_OQ),
+                                                      _mm256_cmp_pd(_mm256_andnot_pd(sign_bit, _mm256_sub_pd(y2_v, _mm256_loadu_pd(&this->hitbox_y2[i]))), r2, _CMP_LT_OQ)));
+        // i is a multiple of 4, so the 4 bits never straddle two words
+        mask[i / 64] |= std::uint64_t(_mm256_movemask_pd(pressed)) << (i % 64);
+    }
+}
+#endif
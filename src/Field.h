@@ -1,8 +1,12 @@
 #ifndef FIELD_H
 #define FIELD_H
 #include <vector>
+#include <cstdint>
 #include <tuple>
 #include <initializer_list>
+#include <algorithm>
+
+class CouplerCurve;
 
 // USE A R THAT IS R_BUTTON/SQRT(2) OF THE BUTTON RADIUS R_BUTTON
 // THIS IS TO MAKE THE SQUARE HITBOX BE FULLY INSIDE THE CIRCLE HITBOX
@@ -17,6 +21,26 @@ struct ButtonPair
     double r2;
 };
 
+// Shrinks [low, high] to the times at which a point moving from start by delta is strictly inside [center - r, center + r]
+// Shared by the swept tests of Field and StaticField
+constexpr void clipToHitbox(double start, double delta, double center, double r, double &low, double &high)
+{
+    if (delta == 0)
+    {
+        if (!(start - center < r && center - start < r))
+        {
+            high = -1;
+        }
+        return;
+    }
+    double enter = (center - r - start) / delta;
+    double leave = (center + r - start) / delta;
+    low = std::max(low, std::min(enter, leave));
+    high = std::min(high, std::max(enter, leave));
+}
+
+// Fields with many button pairs keep a uniform grid over the first hitboxes, so a query only looks at the pairs
+// around the first coupler head top point instead of scanning all of them
 class Field
 {
 public:
@@ -25,15 +49,98 @@ public:
 
     void addButtonPair(ButtonPair button_pair);
 
-    std::vector<ButtonPair> getButtonPairs();
+    // The button pairs in the order they were added, without copying them. Valid until the next addButtonPair
+    const std::vector<ButtonPair> &getButtonPairs() const;
+    int getButtonPairCount() const;
+    // Smallest hitbox radius of all button pairs, infinity if there are none
+    double getSmallestHitboxRadius() const;
+    // Distance the coupler head top points have to travel before a button pair that is not pressed now becomes pressed
+    // Measured on the square hitboxes, so it never overestimates the euclidean distance. Infinity if there is no such pair
+    double getClearance(std::tuple<double, double> mech_pos_1, std::tuple<double, double> mech_pos_2) const;
 
     // Returns the index of the first button pair that is being pressed by the coupler head given by the positions
     // Returns -1 if no button is being pressed
     // USES A SQUARE HIT BOX TO INCREASE PERFORMANCE
-    int getButtonPairPressedIndex(std::tuple<double, double> mech_pos_1, std::tuple<double, double> mech_pos_2);
+    int getButtonPairPressedIndex(std::tuple<double, double> mech_pos_1, std::tuple<double, double> mech_pos_2) const;
+    // Every button pair that is being pressed: bit i % 64 of mask[i / 64] is set if pair i is pressed
+    // The mask is resized to getPressedMaskWords() words, so a mask that is reused is not reallocated
+    // Fields with a grid only test the pairs around the first point, the others test all pairs with vector compares
+    // (AVX-512 or AVX2 when the compiler targets them)
+    void getPressedMask(std::tuple<double, double> mech_pos_1, std::tuple<double, double> mech_pos_2, std::vector<std::uint64_t> &mask) const;
+    int getPressedMaskWords() const;
+    // Swept versions of the two queries above, for coupler head top points that moved in a straight line from the
+    // previous to the current positions. A pair counts if both points were inside their hitboxes at the same moment
+    // of the move. The real path is an arc, not the chord, so a hitbox the arc only grazes can be missed and a hitbox
+    // the chord cuts across can be reported
+    int getButtonPairSweptIndex(std::tuple<double, double> previous_pos_1, std::tuple<double, double> previous_pos_2,
+                                std::tuple<double, double> mech_pos_1, std::tuple<double, double> mech_pos_2) const;
+    void getSweptPressedMask(std::tuple<double, double> previous_pos_1, std::tuple<double, double> previous_pos_2,
+                             std::tuple<double, double> mech_pos_1, std::tuple<double, double> mech_pos_2, std::vector<std::uint64_t> &mask) const;
+    // The same queries over every pose of a cached coupler curve, so a mechanism swept once can be scored against many fields
+    // Pairs pressed at any pose, in the mask layout of getPressedMask
+    void getCurvePressedMask(const CouplerCurve &curve, std::vector<std::uint64_t> &mask) const;
+    // Pairs swept by the moves between consecutive poses of each segment, or pressed at its first pose
+    void getCurveSweptPressedMask(const CouplerCurve &curve, std::vector<std::uint64_t> &mask) const;
+    // Smallest clearance over all poses: how close the coupler head comes to a pair it is not pressing at that moment
+    double getCurveClearance(const CouplerCurve &curve) const;
 
 private:
     std::vector<ButtonPair> ButtonPairs;
-    bool isButtonPairPressed(std::tuple<double, double> mech_pos_1, std::tuple<double, double> mech_pos_2, ButtonPair button_pair);
+    // The same hitboxes as a structure of arrays, for the queries
+    std::vector<double> hitbox_x1;
+    std::vector<double> hitbox_y1;
+    std::vector<double> hitbox_r1;
+    std::vector<double> hitbox_x2;
+    std::vector<double> hitbox_y2;
+    std::vector<double> hitbox_r2;
+    // Appends the pair to both layouts, without touching the grid
+    void storeButtonPair(const ButtonPair &button_pair);
+    bool isButtonPairPressed(double x1, double y1, double x2, double y2, int index) const;
+    // Whether both points were inside the hitboxes of the pair at the same moment, moving from (x1, y1), (x2, y2) by (dx1, dy1), (dx2, dy2)
+    bool wasButtonPairSwept(double x1, double y1, double dx1, double dy1, double x2, double y2, double dx2, double dy2, int index) const;
+    // Calls visitor(index) for the pairs a first point moving from (x1, y1) by (dx1, dy1) may have entered,
+    // the pairs of the grid cells around the move or all of them. A pair can be visited more than once
+    template <typename Visitor>
+    void forEachSweptCandidate(double x1, double y1, double dx1, double dy1, Visitor visitor) const;
+    // Distance of the top points to the hitboxes of a pair that is not pressed, negative if it is pressed
+    double getButtonPairDistance(double x1, double y1, double x2, double y2, int index) const;
+    // Sets the bits of the pressed pairs in the mask, leaving the other bits as they are
+    void orPressedBits(double x1, double y1, double x2, double y2, std::uint64_t *mask) const;
+    void orSweptBits(double x1, double y1, double x2, double y2, double dx1, double dy1, double dx2, double dy2, std::uint64_t *mask) const;
+    // Sets the bits of the pressed pairs in [begin, end)
+    void setPressedBits(double x1, double y1, double x2, double y2, int begin, int end, std::uint64_t *mask) const;
+#if defined(__AVX512F__)
+    // 8 pairs per iteration, begin and end must be multiples of 8
+    void setPressedBitsAvx512(double x1, double y1, double x2, double y2, int begin, int end, std::uint64_t *mask) const;
+#elif defined(__AVX2__)
+    // 4 pairs per iteration, begin and end must be multiples of 4
+    void setPressedBitsAvx2(double x1, double y1, double x2, double y2, int begin, int end, std::uint64_t *mask) const;
+#endif
+    double smallest_hitbox_radius;
+
+    // Below this many pairs a linear scan is faster than the grid
+    static constexpr int GRID_MIN_PAIRS = 16;
+    // The grid covers the first hitboxes plus this fraction of their extent on every side, so pairs added later
+    // near the others do not force a rebuild
+    static constexpr double GRID_MARGIN = 0.25;
+    // Rebuilds the grid from all pairs, with about one cell per pair
+    void buildGrid();
+    // Adds one pair to the cells its first hitbox overlaps, rebuilding the grid if the pair does not fit
+    void addToGrid(int index);
+    // Lists the pair in the cells its first hitbox overlaps, clamped to the grid
+    void insertIntoGrid(int index);
+    // Cell column or row of a coordinate, not clamped to the grid
+    int getGridColumn(double x) const;
+    int getGridRow(double y) const;
+    bool has_grid;
+    // Number of pairs when the grid was built. The cell size is chosen for it, so the grid is rebuilt when it doubles
+    int grid_built_size;
+    double grid_x;
+    double grid_y;
+    double grid_cell_size;
+    int grid_columns;
+    int grid_rows;
+    // Indices of the pairs whose first hitbox overlaps each cell, in increasing order. Row major
+    std::vector<std::vector<int>> grid_cells;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "FitnessCache.h"
+#include <algorithm>
+#include <cstring>
+
+FitnessCache::FitnessCache(int capacity)
+{
+    this->capacity = std::max(capacity, 1);
+    this->hit_count = 0;
+    this->miss_count = 0;
+    // Small caches keep one shard and an exact LRU order
+    int shard_count = std::max(1, std::min(this->capacity / 256, 16));
+    int shard_capacity = (this->capacity + shard_count - 1) / shard_count;
+    // At least two buckets per entry, as a power of two so the bucket is a mask of the hash
+    int bucket_count = 1;
+    while (bucket_count < 2 * shard_capacity)
+    {
+        bucket_count *= 2;
+    }
+    for (int i = 0; i < shard_count; i++)
+    {
+        this->shards.push_back(std::make_unique<Shard>());
+        this->shards[i]->entries.resize(shard_capacity);
+        this->shards[i]->buckets.assign(bucket_count, -1);
+    }
+}
+
+bool FitnessCache::find(const Genome &genome, double &fitness)
+{
+    Key key = getKey(genome);
+    std::uint64_t hash = getHash(key);
+    Shard &shard = getShard(hash);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    int index = findEntry(shard, key, hash);
+    if (index < 0)
+    {
+        this->miss_count++;
+        return false;
+    }
+    unlinkEntry(shard, index);
+    linkNewest(shard, index);
+    fitness = shard.entries[index].fitness;
+    this->hit_count++;
+    return true;
+}
+
+void FitnessCache::insert(const Genome &genome, double fitness)
+{
+    Key key = getKey(genome);
+    std::uint64_t hash = getHash(key);
+    Shard &shard = getShard(hash);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    int index = findEntry(shard, key, hash);
+    if (index >= 0)
+    {
+        // Another worker evaluated the same genome first
+        shard.entries[index].fitness = fitness;
+        unlinkEntry(shard, index);
+        linkNewest(shard, index);
+        return;
+    }
+    if (shard.used < (int)shard.entries.size())
+    {
+        index = shard.used++;
+    }
+    else
+    {
+        // Evicts the least recently used entry, removing it from its bucket first
+        index = shard.oldest;
+        unlinkEntry(shard, index);
+        int *link = &shard.buckets[shard.entries[index].hash & (shard.buckets.size() - 1)];
+        while (*link != index)
+        {
+            link = &shard.entries[*link].next_in_bucket;
+        }
+        *link = shard.entries[index].next_in_bucket;
+    }
+    int &bucket = shard.buckets[hash & (shard.buckets.size() - 1)];
+    Entry &entry = shard.entries[index];
+    entry.key = key;
+    entry.hash = hash;
+    entry.fitness = fitness;
+    entry.next_in_bucket = bucket;
+    bucket = index;
+    linkNewest(shard, index);
+}
+
+int FitnessCache::size() const
+{
+    int size = 0;
+    for (const std::unique_ptr<Shard> &shard : this->shards)
+    {
+        std::unique_lock<std::mutex> lock(shard->mutex);
+        size += shard->used;
+    }
+    return size;
+}
+
+int FitnessCache::getCapacity() const
+{
+    return this->capacity;
+}
+
+long FitnessCache::getHitCount() const
+{
+    return this->hit_count;
+}
+
+long FitnessCache::getMissCount() const
+{
+    return this->miss_count;
+}
+
+FitnessCache::Key FitnessCache::getKey(const Genome &genome)
+{
+    Key key;
+    std::memcpy(key.data(), genome.data(), sizeof(Key));
+    return key;
+}
+
+std::uint64_t FitnessCache::getHash(const Key &key)
+{
+    // One multiply per coordinate, then the SplitMix64 finalizer RandomStream uses mixes the bits once
+    std::uint64_t hash = 0;
+    for (std::uint64_t coordinate : key)
+    {
+        hash = (hash ^ coordinate) * 0x9e3779b97f4a7c15;
+    }
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111eb;
+    return hash ^ (hash >> 31);
+}
+
+FitnessCache::Shard &FitnessCache::getShard(std::uint64_t hash)
+{
+    // The high bits, the low ones pick the bucket inside the shard
+    return *this->shards[(hash >> 32) % this->shards.size()];
+}
+
+int FitnessCache::findEntry(Shard &shard, const Key &key, std::uint64_t hash)
+{
+    int index = shard.buckets[hash & (shard.buckets.size() - 1)];
+    while (index >= 0 && (shard.entries[index].hash != hash || shard.entries[index].key != key))
+    {
+        index = shard.entries[index].next_in_bucket;
+    }
+    return index;
+}
+
+void FitnessCache::unlinkEntry(Shard &shard, int index)
+{
+    Entry &entry = shard.entries[index];
+    if (entry.newer >= 0)
+    {
+        shard.entries[entry.newer].older = entry.older;
+    }
+    else
+    {
+        shard.newest = entry.older;
+    }
+    if (entry.older >= 0)
+    {
+        shard.entries[entry.older].newer = entry.newer;
+    }
+    else
+    {
+        shard.oldest = entry.newer;
+    }
+}
+
+void FitnessCache::linkNewest(Shard &shard, int index)
+{
+    Entry &entry = shard.entries[index];
+    entry.newer = -1;
+    entry.older = shard.newest;
+    if (shard.newest >= 0)
+    {
+        shard.entries[shard.newest].newer = index;
+    }
+    else
+    {
+        shard.oldest = index;
+    }
+    shard.newest = index;
+}
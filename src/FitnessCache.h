@@ -0,0 +1,74 @@
+#ifndef FITNESSCACHE_H
+#define FITNESSCACHE_H
+
+#include <vector>
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include "Genome.h"
+
+// Fitnesses of already evaluated genomes, keyed by the exact bits of the genome, so a hit is the fitness of the same genome
+// Holds at most capacity genomes and evicts the least recently used one. The genomes are split between shards by
+// their hash, each with its own lock and its own LRU order, so the workers rarely wait for each other and the
+// eviction is only approximately LRU over the whole cache
+// Every buffer is allocated by the constructor, looking up and inserting genomes does not allocate
+class FitnessCache
+{
+public:
+    FitnessCache(int capacity);
+    FitnessCache(const FitnessCache &) = delete;
+    FitnessCache &operator=(const FitnessCache &) = delete;
+
+    // Sets fitness and returns true if the genome is cached, counts a hit or a miss
+    bool find(const Genome &genome, double &fitness);
+    // Caches the fitness of the genome, evicting the least recently used genome of its shard if it is full
+    void insert(const Genome &genome, double fitness);
+
+    int size() const;
+    int getCapacity() const;
+    long getHitCount() const;
+    long getMissCount() const;
+
+private:
+    using Key = std::array<std::uint64_t, 12>;
+
+    struct Entry
+    {
+        Key key;
+        std::uint64_t hash;
+        double fitness;
+        // Next entry of the same bucket, and the neighbours in the LRU order, -1 for none
+        int next_in_bucket;
+        int newer;
+        int older;
+    };
+
+    struct alignas(64) Shard
+    {
+        // Guards everything below
+        std::mutex mutex;
+        std::vector<Entry> entries;
+        // First entry of every bucket, -1 for none
+        std::vector<int> buckets;
+        int used = 0;
+        // Most and least recently used entries
+        int newest = -1;
+        int oldest = -1;
+    };
+
+    static Key getKey(const Genome &genome);
+    static std::uint64_t getHash(const Key &key);
+    Shard &getShard(std::uint64_t hash);
+    // Index of the entry with the key in the shard, -1 if there is none
+    static int findEntry(Shard &shard, const Key &key, std::uint64_t hash);
+    static void unlinkEntry(Shard &shard, int index);
+    static void linkNewest(Shard &shard, int index);
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    int capacity;
+    std::atomic<long> hit_count;
+    std::atomic<long> miss_count;
+};
+#endif
\ No newline at end of file
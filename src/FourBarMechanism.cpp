@@ -5,7 +5,17 @@
 #include <sstream>
 #include <iomanip>
 #include <string>
+#include <algorithm>
+#include <limits>
 #include "FourBarMechanism.h"
+#include "Dual.h"
+
+// Unqualified math calls also find the overloads of the Dual scalar type
+using std::abs;
+using std::cos;
+using std::pow;
+using std::sin;
+using std::sqrt;
 
 // To print tuples
 template <class Ch, class Tr, class... Args>
@@ -36,51 +46,62 @@ public:
 
 // TODO
 // Recode this for copyright reasons
-std::optional<std::tuple<std::tuple<double, double>, std::tuple<double, double>>> intersectTwoCircles(double x1, double y1, double r1, double x2, double y2, double r2)
-{
-    double centerdx = x1 - x2;
-    double centerdy = y1 - y2;
-    double R = std::sqrt(centerdx * centerdx + centerdy * centerdy);
-    if (!(std::abs(r1 - r2) <= R && R <= r1 + r2))
-    {                                                                                                   // no intersection
-        throw CirclesDoNotIntersect("The circles do not intersect, hence a linkage can not move here"); // empty list of results
+template <typename Scalar>
+std::optional<std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>>> intersectTwoCircles(Scalar x1, Scalar y1, Scalar r1, Scalar x2, Scalar y2, Scalar r2)
+{
+    Scalar centerdx = x1 - x2;
+    Scalar centerdy = y1 - y2;
+    Scalar R = sqrt(centerdx * centerdx + centerdy * centerdy);
+    if (!(abs(r1 - r2) <= R && R <= r1 + r2))
+    { // no intersection
+        return std::nullopt;
     }
     // intersection(s) should exist
 
-    double R2 = R * R;
-    double R4 = R2 * R2;
-    double a = (r1 * r1 - r2 * r2) / (2 * R2);
-    double r2r2 = (r1 * r1 - r2 * r2);
-    double c = std::sqrt(2 * (r1 * r1 + r2 * r2) / R2 - (r2r2 * r2r2) / R4 - 1);
+    Scalar R2 = R * R;
+    Scalar R4 = R2 * R2;
+    Scalar a = (r1 * r1 - r2 * r2) / (2 * R2);
+    Scalar r2r2 = (r1 * r1 - r2 * r2);
+    Scalar c = sqrt(std::max(Scalar(0), 2 * (r1 * r1 + r2 * r2) / R2 - (r2r2 * r2r2) / R4 - 1));
 
-    double fx = (x1 + x2) / 2 + a * (x2 - x1);
-    double gx = c * (y2 - y1) / 2;
-    double ix1 = fx + gx;
-    double ix2 = fx - gx;
+    Scalar fx = (x1 + x2) / 2 + a * (x2 - x1);
+    Scalar gx = c * (y2 - y1) / 2;
+    Scalar ix1 = fx + gx;
+    Scalar ix2 = fx - gx;
 
-    double fy = (y1 + y2) / 2 + a * (y2 - y1);
-    double gy = c * (x1 - x2) / 2;
-    double iy1 = fy + gy;
-    double iy2 = fy - gy;
+    Scalar fy = (y1 + y2) / 2 + a * (y2 - y1);
+    Scalar gy = c * (x1 - x2) / 2;
+    Scalar iy1 = fy + gy;
+    Scalar iy2 = fy - gy;
 
     // note if gy == 0 and gx == 0 then the circles are tangent and there is only one solution
     // but that one solution will just be duplicated as the code is currently written
     return std::make_tuple(std::make_tuple(ix1, iy1), std::make_tuple(ix2, iy2));
 }
 
-double FourBarMechanism::getTotalEnergy()
+template <typename Scalar>
+Scalar BasicFourBarMechanism<Scalar>::getTotalEnergy()
 {
+    if (this->energies_outdated)
+    {
+        updateEnergies();
+    }
     return input_link.getEnergy() + output_link.getEnergy() + coupler_link.getEnergy() + coupler_head.getEnergy();
 }
 
-FourBarMechanism::FourBarMechanism(Link crank_link, Link in_coupler_link, Link in_output_link, CouplerHead in_coupler_head) : input_link(crank_link),
-                                                                                                                              coupler_link(in_coupler_link),
-                                                                                                                              output_link(in_output_link),
-                                                                                                                              coupler_head(in_coupler_head)
+template <typename Scalar>
+BasicFourBarMechanism<Scalar>::BasicFourBarMechanism(BasicLink<Scalar> crank_link, BasicLink<Scalar> in_coupler_link, BasicLink<Scalar> in_output_link, BasicCouplerHead<Scalar> in_coupler_head) : input_link(crank_link),
+                                                                                                                                                                            coupler_link(in_coupler_link),
+                                                                                                                                                                            output_link(in_output_link),
+                                                                                                                                                                            coupler_head(in_coupler_head)
 {
+    computeFeasibleAngles();
+    this->crank_angular_speed = 0;
+    this->energies_outdated = true;
 }
 
-constexpr double det(const double matrix[3][3])
+template <typename Scalar>
+constexpr Scalar det(const Scalar matrix[3][3])
 {
     return matrix[0][0] * matrix[1][1] * matrix[2][2] + matrix[0][1] * matrix[1][2] * matrix[2][0] + matrix[0][2] * matrix[1][0] * matrix[2][1] - matrix[0][2] * matrix[1][1] * matrix[2][0] - matrix[0][1] * matrix[1][0] * matrix[2][2] - matrix[0][0] * matrix[1][2] * matrix[2][1];
 }
@@ -98,7 +119,8 @@ public:
     }
 };
 
-constexpr std::tuple<double, double> getCircleCenter(const std::tuple<double, double> a1, const std::tuple<double, double> a2, const std::tuple<double, double> a3)
+template <typename Scalar>
+constexpr std::tuple<Scalar, Scalar> getCircleCenter(const std::tuple<Scalar, Scalar> a1, const std::tuple<Scalar, Scalar> a2, const std::tuple<Scalar, Scalar> a3)
 {
     // We know that the distance from our point x,y must be equal to r in each of the 3 points
     // The formula of the circle is
@@ -114,132 +136,453 @@ constexpr std::tuple<double, double> getCircleCenter(const std::tuple<double, do
     // a*a3 + b*b3 + c = -(a3^2+b3^2)
 
     // Given our 3 results d1,d2,d3
-    double d1 = -(std::pow(std::get<0>(a1), 2) + std::pow(std::get<1>(a1), 2));
-    double d2 = -(std::pow(std::get<0>(a2), 2) + std::pow(std::get<1>(a2), 2));
-    double d3 = -(std::pow(std::get<0>(a3), 2) + std::pow(std::get<1>(a3), 2));
+    Scalar d1 = -(pow(std::get<0>(a1), 2) + pow(std::get<1>(a1), 2));
+    Scalar d2 = -(pow(std::get<0>(a2), 2) + pow(std::get<1>(a2), 2));
+    Scalar d3 = -(pow(std::get<0>(a3), 2) + pow(std::get<1>(a3), 2));
 
     // Our Cramer's rule matrices are
-    double D[3][3] = {
+    Scalar D[3][3] = {
         {std::get<0>(a1), std::get<1>(a1), 1},
         {std::get<0>(a2), std::get<1>(a2), 1},
         {std::get<0>(a3), std::get<1>(a3), 1}};
-    double Dx[3][3] = {
+    Scalar Dx[3][3] = {
         {d1, std::get<1>(a1), 1},
         {d2, std::get<1>(a2), 1},
         {d3, std::get<1>(a3), 1}};
-    double Dy[3][3] = {
+    Scalar Dy[3][3] = {
         {std::get<0>(a1), d1, 1},
         {std::get<0>(a2), d2, 1},
         {std::get<0>(a3), d3, 1}};
-    // double Dz[3][3] = {
+    // Scalar Dz[3][3] = {
     // {std::get<0>(a1), std::get<1>(a1), d1},
     // {std::get<0>(a2), std::get<1>(a2), d2},
     // {std::get<0>(a3), std::get<1>(a3), d3}};
 
     // Now we calculate our coefficients
-    double detD = det(D);
+    Scalar detD = det(D);
     if (detD == 0)
     {
         throw CouplerRootPointsAreColinear("The coupler root points are colinear. Division by Zero error iminent!");
     }
-    double detDx = det(Dx);
-    double detDy = det(Dy);
-    //  double detDz = det(Dz);
+    Scalar detDx = det(Dx);
+    Scalar detDy = det(Dy);
+    //  Scalar detDz = det(Dz);
 
-    double a = detDx / detD;
-    double b = detDy / detD;
-    // double c = detDz / detD;
+    Scalar a = detDx / detD;
+    Scalar b = detDy / detD;
+    // Scalar c = detDz / detD;
 
-    double x = -a / 2;
-    double y = -b / 2;
+    Scalar x = -a / 2;
+    Scalar y = -b / 2;
     return std::make_tuple(x, y);
 }
 
-constexpr std::tuple<std::tuple<double, double>, std::tuple<double, double>> FourBarMechanism::getLinkPositionsFromCouplers(
-    const std::tuple<std::tuple<double, double>, std::tuple<double, double>> coupler_pos_1,
-    const std::tuple<std::tuple<double, double>, std::tuple<double, double>> coupler_pos_2,
-    const std::tuple<std::tuple<double, double>, std::tuple<double, double>> coupler_pos_3)
+template <typename Scalar>
+constexpr std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> BasicFourBarMechanism<Scalar>::getLinkPositionsFromCouplers(
+    const std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> coupler_pos_1,
+    const std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> coupler_pos_2,
+    const std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> coupler_pos_3)
 {
-    const std::tuple<double, double> a1 = std::get<0>(coupler_pos_1);
-    const std::tuple<double, double> b1 = std::get<1>(coupler_pos_1);
-    const std::tuple<double, double> a2 = std::get<0>(coupler_pos_2);
-    const std::tuple<double, double> b2 = std::get<1>(coupler_pos_2);
-    const std::tuple<double, double> a3 = std::get<0>(coupler_pos_3);
-    const std::tuple<double, double> b3 = std::get<1>(coupler_pos_3);
+    const std::tuple<Scalar, Scalar> a1 = std::get<0>(coupler_pos_1);
+    const std::tuple<Scalar, Scalar> b1 = std::get<1>(coupler_pos_1);
+    const std::tuple<Scalar, Scalar> a2 = std::get<0>(coupler_pos_2);
+    const std::tuple<Scalar, Scalar> b2 = std::get<1>(coupler_pos_2);
+    const std::tuple<Scalar, Scalar> a3 = std::get<0>(coupler_pos_3);
+    const std::tuple<Scalar, Scalar> b3 = std::get<1>(coupler_pos_3);
 
-    const std::tuple<double, double> crank_link_root = getCircleCenter(a1, a2, a3);
-    const std::tuple<double, double> output_link_root = getCircleCenter(b1, b2, b3);
+    const std::tuple<Scalar, Scalar> crank_link_root = getCircleCenter(a1, a2, a3);
+    const std::tuple<Scalar, Scalar> output_link_root = getCircleCenter(b1, b2, b3);
 
     return std::make_tuple(crank_link_root, output_link_root);
 }
 
-FourBarMechanism::FourBarMechanism(CouplerHead coupler_head1, CouplerHead coupler_head2, CouplerHead coupler_head3, double linear_density)
+template <typename Scalar>
+BasicFourBarMechanism<Scalar>::BasicFourBarMechanism(BasicCouplerHead<Scalar> coupler_head1, BasicCouplerHead<Scalar> coupler_head2, BasicCouplerHead<Scalar> coupler_head3, Scalar linear_density)
 {
-    std::tuple<std::tuple<double, double>, std::tuple<double, double>> coupler_pos_1 = coupler_head1.getBaseCouplerPositions();
-    std::tuple<std::tuple<double, double>, std::tuple<double, double>> coupler_pos_2 = coupler_head2.getBaseCouplerPositions();
-    std::tuple<std::tuple<double, double>, std::tuple<double, double>> coupler_pos_3 = coupler_head3.getBaseCouplerPositions();
+    std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> coupler_pos_1 = coupler_head1.getBaseCouplerPositions();
+    std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> coupler_pos_2 = coupler_head2.getBaseCouplerPositions();
+    std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> coupler_pos_3 = coupler_head3.getBaseCouplerPositions();
     auto [crank_link_root, output_link_root] = getLinkPositionsFromCouplers(coupler_pos_1, coupler_pos_2, coupler_pos_3);
-    input_link = Link(crank_link_root, std::get<0>(coupler_pos_1), linear_density);
-    output_link = Link(std::get<1>(coupler_pos_1), output_link_root, linear_density);
-    coupler_link = Link(std::get<0>(coupler_pos_1), std::get<1>(coupler_pos_1), linear_density);
+    input_link = BasicLink<Scalar>(crank_link_root, std::get<0>(coupler_pos_1), linear_density);
+    output_link = BasicLink<Scalar>(std::get<1>(coupler_pos_1), output_link_root, linear_density);
+    coupler_link = BasicLink<Scalar>(std::get<0>(coupler_pos_1), std::get<1>(coupler_pos_1), linear_density);
     coupler_head = coupler_head1;
+    computeFeasibleAngles();
+    this->crank_angular_speed = 0;
+    this->energies_outdated = true;
 }
 
-FourBarMechanism::FourBarMechanism(const FourBarMechanism &other)
+template <typename Scalar>
+BasicFourBarMechanism<Scalar>::BasicFourBarMechanism(const BasicFourBarMechanism &other)
 {
     this->input_link = other.input_link;
     this->output_link = other.output_link;
     this->coupler_link = other.coupler_link;
     this->coupler_head = other.coupler_head;
+    this->feasible_center = other.feasible_center;
+    this->feasible_min_offset = other.feasible_min_offset;
+    this->feasible_max_offset = other.feasible_max_offset;
+    this->crank_angular_speed = other.crank_angular_speed;
+    this->energies_outdated = other.energies_outdated;
 }
 
-void FourBarMechanism::rotate(double angle, double dt)
+template <typename Scalar>
+void BasicFourBarMechanism<Scalar>::computeFeasibleAngles()
 {
-    if (std::abs(angle - this->input_link.getTheta()) < 0.00001)
+    auto [xa, ya] = toDouble(this->input_link.getPos());
+    auto [xd, yd] = toDouble(this->output_link.getPos2());
+    double a = static_cast<double>(this->input_link.getL());
+    double b = static_cast<double>(this->coupler_link.getL());
+    double c = static_cast<double>(this->output_link.getL());
+    double g = std::sqrt(std::pow(xd - xa, 2) + std::pow(yd - ya, 2));
+    this->feasible_center = std::atan2(yd - ya, xd - xa);
+
+    // The distance s between the crank tip and the output ground follows
+    // s^2 = a^2 + g^2 - 2ag cos(theta - center)
+    // and the coupler and output link can only reach it when |b - c| <= s <= b + c
+    if (a * g == 0)
     {
-        std::cout << " no move";
+        // s does not depend on the crank angle
+        double distance = std::sqrt(a * a + g * g);
+        bool closes = std::abs(b - c) <= distance && distance <= b + c;
+        this->feasible_min_offset = 0;
+        this->feasible_max_offset = closes ? PI : -1;
+        return;
+    }
+    double cos_lower = (a * a + g * g - (b + c) * (b + c)) / (2 * a * g);
+    double cos_upper = (a * a + g * g - (b - c) * (b - c)) / (2 * a * g);
+    if (cos_lower > cos_upper || cos_lower > 1 || cos_upper < -1)
+    {
+        // Can not be assembled at any angle
+        this->feasible_min_offset = 0;
+        this->feasible_max_offset = -1;
         return;
     }
+    this->feasible_max_offset = cos_lower <= -1 ? PI : std::acos(cos_lower);
+    this->feasible_min_offset = cos_upper >= 1 ? 0 : std::acos(cos_upper);
+}
+
+template <typename Scalar>
+LinkageType BasicFourBarMechanism<Scalar>::getLinkageType() const
+{
+    auto [xa, ya] = toDouble(this->input_link.getPos());
+    auto [xd, yd] = toDouble(this->output_link.getPos2());
+    double ground = std::sqrt(std::pow(xd - xa, 2) + std::pow(yd - ya, 2));
+    double lengths[4] = {static_cast<double>(this->input_link.getL()), static_cast<double>(this->coupler_link.getL()), static_cast<double>(this->output_link.getL()), ground};
+    int shortest = std::min_element(lengths, lengths + 4) - lengths;
+    double longest = *std::max_element(lengths, lengths + 4);
+    double total = lengths[0] + lengths[1] + lengths[2] + lengths[3];
+    double shortest_plus_longest = lengths[shortest] + longest;
+    double others = total - shortest_plus_longest;
+    // Lengths come from positions, so equality is only checked up to rounding
+    double tolerance = 1e-12 * total;
+    if (std::abs(shortest_plus_longest - others) <= tolerance)
+    {
+        return LinkageType::ChangePoint;
+    }
+    if (shortest_plus_longest > others)
+    {
+        return LinkageType::TripleRocker;
+    }
+    switch (shortest)
+    {
+    case 0:
+        return LinkageType::CrankRocker;
+    case 1:
+        return LinkageType::GrashofDoubleRocker;
+    case 2:
+        return LinkageType::RockerCrank;
+    default:
+        return LinkageType::DoubleCrank;
+    }
+}
+
+template <typename Scalar>
+std::vector<AngleInterval> BasicFourBarMechanism<Scalar>::getFeasibleAngleIntervals() const
+{
+    std::array<AngleInterval, MAX_FEASIBLE_INTERVALS> intervals;
+    int count = getFeasibleAngleIntervals(intervals);
+    return std::vector<AngleInterval>(intervals.begin(), intervals.begin() + count);
+}
+
+template <typename Scalar>
+int BasicFourBarMechanism<Scalar>::getFeasibleAngleIntervals(std::array<AngleInterval, MAX_FEASIBLE_INTERVALS> &intervals) const
+{
+    int count = 0;
+    double center = this->feasible_center;
+    double min_offset = this->feasible_min_offset;
+    double max_offset = this->feasible_max_offset;
+    if (max_offset < min_offset)
+    {
+        return count;
+    }
+    if (min_offset == 0 && max_offset == PI)
+    {
+        intervals[count++] = AngleInterval{0, 2 * PI};
+        return count;
+    }
+
+    // One interval around the center, one around the opposite direction, or one on each side of the center
+    AngleInterval unwrapped[2];
+    int unwrapped_count = 0;
+    if (min_offset == 0)
+    {
+        unwrapped[unwrapped_count++] = AngleInterval{center - max_offset, center + max_offset};
+    }
+    else if (max_offset == PI)
+    {
+        unwrapped[unwrapped_count++] = AngleInterval{center + min_offset, center + 2 * PI - min_offset};
+    }
+    else
+    {
+        unwrapped[unwrapped_count++] = AngleInterval{center + min_offset, center + max_offset};
+        unwrapped[unwrapped_count++] = AngleInterval{center - max_offset, center - min_offset};
+    }
+
+    for (int i = 0; i < unwrapped_count; i++)
+    {
+        double shift = -2 * PI * std::floor(unwrapped[i].start / (2 * PI));
+        double start = unwrapped[i].start + shift;
+        double end = unwrapped[i].end + shift;
+        if (end > 2 * PI)
+        {
+            intervals[count++] = AngleInterval{start, 2 * PI};
+            intervals[count++] = AngleInterval{0, end - 2 * PI};
+        }
+        else
+        {
+            intervals[count++] = AngleInterval{start, end};
+        }
+    }
+    std::sort(intervals.begin(), intervals.begin() + count, [](const AngleInterval &first, const AngleInterval &second)
+              { return first.start < second.start; });
+    return count;
+}
+
+template <typename Scalar>
+bool BasicFourBarMechanism<Scalar>::isAngleFeasible(double angle) const
+{
+    double offset = std::abs(std::remainder(angle - this->feasible_center, 2 * PI));
+    return this->feasible_min_offset <= offset && offset <= this->feasible_max_offset;
+}
+
+// Whether the square of half side r around (x, y) has a point between the circles of radius inner and outer around (center_x, center_y)
+static bool squareTouchesAnnulus(double center_x, double center_y, double inner, double outer, double x, double y, double r)
+{
+    // Closest and farthest points of the square to the center
+    double near_x = std::max(x - r, std::min(center_x, x + r)) - center_x;
+    double near_y = std::max(y - r, std::min(center_y, y + r)) - center_y;
+    double far_x = std::max(std::abs(x - r - center_x), std::abs(x + r - center_x));
+    double far_y = std::max(std::abs(y - r - center_y), std::abs(y + r - center_y));
+    // Rounding of the radii must never reject a reachable box
+    double margin = 1e-9 * (outer + r + 1);
+    return std::sqrt(near_x * near_x + near_y * near_y) <= outer + margin && std::sqrt(far_x * far_x + far_y * far_y) >= inner - margin;
+}
+
+template <typename Scalar>
+bool BasicFourBarMechanism<Scalar>::canPressButtonPair(const ButtonPair &button_pair) const
+{
+    if (this->feasible_max_offset < this->feasible_min_offset)
+    {
+        return false;
+    }
+    auto [crank_top, output_top] = getCouplerHeadTopPositions();
+    return canTopPointReach(crank_top, button_pair.x1, button_pair.y1, button_pair.r1) && canTopPointReach(output_top, button_pair.x2, button_pair.y2, button_pair.r2);
+}
+
+template <typename Scalar>
+bool BasicFourBarMechanism<Scalar>::canTopPointReach(const std::tuple<Scalar, Scalar> &top_point, double x, double y, double r) const
+{
+    auto [x_top, y_top] = toDouble(top_point);
+    auto [x_ground_1, y_ground_1] = toDouble(this->input_link.getPos());
+    auto [x_crank, y_crank] = toDouble(this->input_link.getPos2());
+    auto [x_pin, y_pin] = toDouble(this->output_link.getPos());
+    auto [x_ground_2, y_ground_2] = toDouble(this->output_link.getPos2());
+    // The pins turn around the ground pivots and the top point keeps its distance to both of them
+    double input_length = static_cast<double>(this->input_link.getL());
+    double output_length = static_cast<double>(this->output_link.getL());
+    double crank_distance = std::sqrt(std::pow(x_top - x_crank, 2) + std::pow(y_top - y_crank, 2));
+    double pin_distance = std::sqrt(std::pow(x_top - x_pin, 2) + std::pow(y_top - y_pin, 2));
+    return squareTouchesAnnulus(x_ground_1, y_ground_1, std::abs(input_length - crank_distance), input_length + crank_distance, x, y, r) &&
+           squareTouchesAnnulus(x_ground_2, y_ground_2, std::abs(output_length - pin_distance), output_length + pin_distance, x, y, r);
+}
+
+template <typename Scalar>
+void BasicFourBarMechanism<Scalar>::rotate(Scalar angle, Scalar dt)
+{
+    RotationStatus status = tryRotate(angle, dt);
+    if (status == RotationStatus::NotMoved)
+    {
+        std::cout << " no move";
+    }
+    else if (status == RotationStatus::Infeasible)
+    {
+        throw CirclesDoNotIntersect("The circles do not intersect, hence a linkage can not move here");
+    }
+}
+
+template <typename Scalar>
+RotationStatus BasicFourBarMechanism<Scalar>::tryRotate(Scalar angle, Scalar dt)
+{
+    if (abs(angle - this->input_link.getTheta()) < 0.00001)
+    {
+        return RotationStatus::NotMoved;
+    }
+    return moveCrankTo(angle, cos(angle), sin(angle), (angle - this->input_link.getTheta()) / dt);
+}
+
+template <typename Scalar>
+RotationStatus BasicFourBarMechanism<Scalar>::moveCrankTo(Scalar angle, Scalar cos_angle, Scalar sin_angle, Scalar angular_speed)
+{
     auto past_pin_joint_pos = this->output_link.getPos();
-    this->input_link.setTheta(angle, dt);
 
-    // The right end of the crank bar
-    double x_crank = this->input_link.getL() * cos(this->input_link.getTheta());
-    double y_crank = this->input_link.getL() * sin(this->input_link.getTheta());
-    double coupler_lenght = this->coupler_link.getL();
-    double output_link_length = this->output_link.getL();
+    // The right end of the crank bar, measured from the crank ground pivot
+    // Nothing is moved until we know the linkage can be assembled at this angle
+    auto [x_ground_1, y_ground_1] = this->input_link.getPos();
+    Scalar x_crank = x_ground_1 + this->input_link.getL() * cos_angle;
+    Scalar y_crank = y_ground_1 + this->input_link.getL() * sin_angle;
+    Scalar coupler_lenght = this->coupler_link.getL();
+    Scalar output_link_length = this->output_link.getL();
     auto [x_ground_2, y_ground_2] = this->output_link.getPos2();
     auto possible_pin_joint_locations = intersectTwoCircles(x_crank, y_crank, coupler_lenght, x_ground_2, y_ground_2, output_link_length);
-
-    // std::cout << past_pin_joint_pos << "\n";
-    // std::cout << std::get<0>(possible_pin_joint_locations.value()) << " " << std::get<1>(possible_pin_joint_locations.value()) << "\n";
+    if (!possible_pin_joint_locations)
+    {
+        return RotationStatus::Infeasible;
+    }
+    this->input_link.setTheta(angle, cos_angle, sin_angle);
 
     auto [x_pin_joint_1, y_pin_joint_1] = std::get<0>(possible_pin_joint_locations.value());
     auto [x_pin_joint_2, y_pin_joint_2] = std::get<1>(possible_pin_joint_locations.value());
     auto [past_x_pin_joint, past_y_pin_joint] = past_pin_joint_pos;
-    double distance_1 = std::sqrt(std::pow(x_pin_joint_1 - past_x_pin_joint, 2) + std::pow(y_pin_joint_1 - past_y_pin_joint, 2));
-    double distance_2 = std::sqrt(std::pow(x_pin_joint_2 - past_x_pin_joint, 2) + std::pow(y_pin_joint_2 - past_y_pin_joint, 2));
+    Scalar distance_1 = sqrt(pow(x_pin_joint_1 - past_x_pin_joint, 2) + pow(y_pin_joint_1 - past_y_pin_joint, 2));
+    Scalar distance_2 = sqrt(pow(x_pin_joint_2 - past_x_pin_joint, 2) + pow(y_pin_joint_2 - past_y_pin_joint, 2));
     // The root of the outputlink is the crank. The end of the outpulink should still be fixed in the ground
-    // std::cout << "distance 1: " << distance_1 << " distance 2: " << distance_2 << "\n";
-    if (distance_1 < distance_2)
+    std::tuple<Scalar, Scalar> pin_joint_pos = distance_1 < distance_2 ? std::make_tuple(x_pin_joint_1, y_pin_joint_1) : std::make_tuple(x_pin_joint_2, y_pin_joint_2);
+    this->output_link.setPos(pin_joint_pos);
+    // The root of the coupler link is the tail of the crank link
+    // The coupler head turns with the coupler link, so the angle is only computed once
+    Scalar coupler_rotation = this->coupler_link.getRotationTo(this->input_link.getPos2(), pin_joint_pos);
+    this->coupler_link.setTwoPositions(this->input_link.getPos2(), pin_joint_pos, this->coupler_link.getTheta() + coupler_rotation);
+    this->coupler_head.move(this->input_link.getPos2(), this->coupler_link.getPos2());
+    this->crank_angular_speed = angular_speed;
+    this->energies_outdated = true;
+    return RotationStatus::Moved;
+}
+
+template <typename Scalar>
+Scalar BasicFourBarMechanism<Scalar>::getCrankAngularSpeed() const
+{
+    return this->crank_angular_speed;
+}
+
+template <typename Scalar>
+void BasicFourBarMechanism<Scalar>::setCrankAngularSpeed(Scalar angular_speed)
+{
+    this->crank_angular_speed = angular_speed;
+    this->energies_outdated = true;
+}
+
+template <typename Scalar>
+void BasicFourBarMechanism<Scalar>::updateEnergies()
+{
+    auto [x_ground_1, y_ground_1] = this->input_link.getPos();
+    auto [x_crank, y_crank] = this->input_link.getPos2();
+    auto [x_pin, y_pin] = this->output_link.getPos();
+    auto [x_ground_2, y_ground_2] = this->output_link.getPos2();
+    // The crank pin turns around the crank ground pivot
+    Scalar crank_vx = -this->crank_angular_speed * (y_crank - y_ground_1);
+    Scalar crank_vy = this->crank_angular_speed * (x_crank - x_ground_1);
+    // Differentiating the loop closure crank + coupler = ground + output gives
+    // v_crank + w_coupler x coupler = w_output x output, both unknowns follow from dotting with the coupler and the output
+    Scalar coupler_x = x_pin - x_crank;
+    Scalar coupler_y = y_pin - y_crank;
+    Scalar output_x = x_pin - x_ground_2;
+    Scalar output_y = y_pin - y_ground_2;
+    // Zero when the coupler and the output link are aligned, at the ends of the feasible range
+    Scalar cross = coupler_x * output_y - coupler_y * output_x;
+    // There the speeds are not defined, and dividing by a cross product left by rounding gives energies as large as 1e29
+    Scalar coupler_angular_speed = Scalar(std::numeric_limits<double>::quiet_NaN());
+    Scalar output_angular_speed = Scalar(std::numeric_limits<double>::quiet_NaN());
+    if (abs(cross) > DEAD_POINT_SINE * this->coupler_link.getL() * this->output_link.getL())
     {
-        this->output_link.setPos(std::make_tuple(x_pin_joint_1, y_pin_joint_1), dt);
+        coupler_angular_speed = -(crank_vx * output_x + crank_vy * output_y) / cross;
+        output_angular_speed = -(crank_vx * coupler_x + crank_vy * coupler_y) / cross;
     }
-    else
+
+    // The centers of mass of the links are at their middle
+    this->input_link.setEnergy(abs(this->crank_angular_speed) * this->input_link.getL() / 2, this->crank_angular_speed);
+    this->output_link.setEnergy(abs(output_angular_speed) * this->output_link.getL() / 2, output_angular_speed);
+    Scalar coupler_vx = crank_vx - coupler_angular_speed * coupler_y / 2;
+    Scalar coupler_vy = crank_vy + coupler_angular_speed * coupler_x / 2;
+    this->coupler_link.setEnergy(sqrt(coupler_vx * coupler_vx + coupler_vy * coupler_vy), coupler_angular_speed);
+    this->coupler_head.setVelocity(crank_vx, crank_vy, coupler_angular_speed);
+    this->energies_outdated = false;
+}
+
+template <typename Scalar>
+std::tuple<double, double> BasicFourBarMechanism<Scalar>::toDouble(const std::tuple<Scalar, Scalar> &point)
+{
+    return std::make_tuple(static_cast<double>(std::get<0>(point)), static_cast<double>(std::get<1>(point)));
+}
+
+template <typename Scalar>
+void BasicFourBarMechanism<Scalar>::advanceSweepDirection(long count, Scalar angle, Scalar cos_step, Scalar sin_step, Scalar &cos_angle, Scalar &sin_angle)
+{
+    if (count % SWEEP_RESYNC_STEPS == 0)
     {
-        this->output_link.setPos(std::make_tuple(x_pin_joint_2, y_pin_joint_2), dt);
+        cos_angle = cos(angle);
+        sin_angle = sin(angle);
+        return;
     }
-    // The root of the coupler link is the tail of the crank link
-    this->coupler_link.setTwoPositions(this->input_link.getPos2(), this->output_link.getPos(), dt);
-    this->coupler_head.move(this->input_link.getPos2(), this->coupler_link.getPos2(), dt);
+    // Rotating (cos, sin) of the current angle by the step gives (cos, sin) of the next one
+    Scalar next_cos = cos_angle * cos_step - sin_angle * sin_step;
+    Scalar next_sin = sin_angle * cos_step + cos_angle * sin_step;
+    // Keeps the vector on the unit circle, first order correction of 1 / sqrt(norm)
+    Scalar correction = (Scalar(3) - (next_cos * next_cos + next_sin * next_sin)) / Scalar(2);
+    cos_angle = next_cos * correction;
+    sin_angle = next_sin * correction;
+}
+
+template <typename Scalar>
+std::optional<std::tuple<typename BasicFourBarMechanism<Scalar>::TopPositions, typename BasicFourBarMechanism<Scalar>::TopPositions>> BasicFourBarMechanism<Scalar>::getBranchTopPositions(Scalar cos_angle, Scalar sin_angle) const
+{
+    auto [x_ground_1, y_ground_1] = this->input_link.getPos();
+    auto [x_ground_2, y_ground_2] = this->output_link.getPos2();
+    std::tuple<Scalar, Scalar> crank_pin = std::make_tuple(x_ground_1 + this->input_link.getL() * cos_angle, y_ground_1 + this->input_link.getL() * sin_angle);
+    auto possible_pin_joint_locations = intersectTwoCircles(std::get<0>(crank_pin), std::get<1>(crank_pin), this->coupler_link.getL(), x_ground_2, y_ground_2, this->output_link.getL());
+    if (!possible_pin_joint_locations)
+    {
+        return std::nullopt;
+    }
+    // The first solution of intersectTwoCircles is offset from the line between the centers by c / 2 * (dy, -dx),
+    // so its assembly side is c / 2 * (dx^2 + dy^2) >= 0: it is always the positive branch
+    auto [positive_pin, negative_pin] = possible_pin_joint_locations.value();
+    return std::make_tuple(this->coupler_head.getTopPositionsAt(crank_pin, positive_pin), this->coupler_head.getTopPositionsAt(crank_pin, negative_pin));
 }
 
-std::string FourBarMechanism::getDumpHeader()
+template <typename Scalar>
+AssemblyBranch BasicFourBarMechanism<Scalar>::getAssemblyBranch() const
+{
+    return getAssemblySide() < 0 ? AssemblyBranch::Negative : AssemblyBranch::Positive;
+}
+
+template <typename Scalar>
+Scalar BasicFourBarMechanism<Scalar>::getAssemblySide() const
+{
+    auto [x_crank, y_crank] = this->input_link.getPos2();
+    auto [x_pin, y_pin] = this->output_link.getPos();
+    auto [x_ground, y_ground] = this->output_link.getPos2();
+    return (x_pin - x_crank) * (y_ground - y_crank) - (y_pin - y_crank) * (x_ground - x_crank);
+}
+
+template <typename Scalar>
+std::string BasicFourBarMechanism<Scalar>::getDumpHeader()
 {
     return std::string("theta,xi,yi,xc,yc,xo,yo,xb,yb,xct,yct,xot,yot,energy");
 }
 
-std::string FourBarMechanism::dumpState()
+template <typename Scalar>
+std::string BasicFourBarMechanism<Scalar>::dumpState()
 {
     // Create an output string stream
     std::ostringstream streamObj;
@@ -266,27 +609,36 @@ std::string FourBarMechanism::dumpState()
     return streamObj.str();
 }
 
-double FourBarMechanism::getAngle()
+template <typename Scalar>
+Scalar BasicFourBarMechanism<Scalar>::getAngle()
 {
     return this->input_link.getTheta();
 }
 
-const std::tuple<std::tuple<double, double>, std::tuple<double, double>> FourBarMechanism::getInputLinkPositions() const
+template <typename Scalar>
+const std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> BasicFourBarMechanism<Scalar>::getInputLinkPositions() const
 {
     return std::make_tuple(this->input_link.getPos(), this->input_link.getPos2());
 }
 
-const std::tuple<std::tuple<double, double>, std::tuple<double, double>> FourBarMechanism::getCouplerLinkPositions() const
+template <typename Scalar>
+const std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> BasicFourBarMechanism<Scalar>::getCouplerLinkPositions() const
 {
     return std::make_tuple(this->coupler_link.getPos(), this->coupler_link.getPos2());
 }
 
-const std::tuple<std::tuple<double, double>, std::tuple<double, double>> FourBarMechanism::getOutputLinkPositions() const
+template <typename Scalar>
+const std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> BasicFourBarMechanism<Scalar>::getOutputLinkPositions() const
 {
     return std::make_tuple(this->output_link.getPos(), this->output_link.getPos2());
 }
 
-const std::tuple<std::tuple<double, double>, std::tuple<double, double>> FourBarMechanism::getCouplerHeadTopPositions() const
+template <typename Scalar>
+const std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> BasicFourBarMechanism<Scalar>::getCouplerHeadTopPositions() const
 {
     return std::make_tuple(this->coupler_head.getCrankTopPos(), this->coupler_head.getOutputTopPos());
-}
\ No newline at end of file
+}
+
+template class BasicFourBarMechanism<double>;
+template class BasicFourBarMechanism<float>;
+template class BasicFourBarMechanism<Dual<double>>;
\ No newline at end of file
@@ -2,38 +2,326 @@
 #ifndef FOURBARMECHANISM_H
 #define FOURBARMECHANISM_H
 
+#include <string>
+#include <cmath>
+#include <vector>
+#include <array>
+#include <optional>
 #include "Link.h"
 #include "CouplerHead.h"
+#include "Field.h"
 
-class FourBarMechanism
+// Outcome of FourBarMechanism::tryRotate
+enum class RotationStatus
+{
+    Moved,
+    // The crank is already at the requested angle
+    NotMoved,
+    // The links can not be assembled at the requested angle. The mechanism keeps its previous pose
+    Infeasible
+};
+
+// Grashof classification of a four bar linkage, named after the motion of the input (crank) and output links
+enum class LinkageType
+{
+    // Shortest + longest < sum of the other two (Grashof)
+    // The input link is the shortest, it turns fully and the output link rocks
+    CrankRocker,
+    // The ground is the shortest, both input and output links turn fully
+    DoubleCrank,
+    // The coupler is the shortest, neither input nor output link turn fully
+    GrashofDoubleRocker,
+    // The output link is the shortest, the input link rocks
+    RockerCrank,
+    // Shortest + longest == sum of the other two, the linkage can flip between assembly modes
+    ChangePoint,
+    // Shortest + longest > sum of the other two (non Grashof), no link turns fully
+    TripleRocker
+};
+
+// The two ways the links can be assembled at a crank angle, named after the sign of the cross product of the coupler
+// and the line from the crank pin to the output ground pivot. A moving mechanism keeps its branch between dead points
+enum class AssemblyBranch
+{
+    Positive,
+    Negative
+};
+
+// What one assembly branch does during FourBarMechanism::evaluateBothBranches
+struct BranchEvaluation
+{
+    // Crank and output top points at every angle where the links can be assembled
+    std::vector<std::tuple<std::tuple<double, double>, std::tuple<double, double>>> coupler_top_path;
+    // One flag per button pair of the field
+    std::vector<bool> pressed_button_pairs;
+    int buttons_pressed;
+};
+
+// Closed range of crank angles, in radians
+struct AngleInterval
+{
+    double start;
+    double end;
+};
+
+// Generic over the scalar type like BasicLink, FourBarMechanism is the double version
+// Feasible angle intervals and the classification are always computed in double
+template <typename Scalar = double>
+class BasicFourBarMechanism
 {
 public:
+    // Crank and output top points of the coupler head
+    using TopPositions = std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>>;
+
     // Simply assembles the mechanism based on the 4 parts. Makes no checks
-    FourBarMechanism(Link input_link, Link coupler_link, Link output_link, CouplerHead coupler_head);
+    BasicFourBarMechanism(BasicLink<Scalar> input_link, BasicLink<Scalar> coupler_link, BasicLink<Scalar> output_link, BasicCouplerHead<Scalar> coupler_head);
     // Will generate the mechanism based on the positions of 3 coupler heads.
     // Input, coupler and output links will be generated automatically to fit the 3 positions.
-    FourBarMechanism(CouplerHead coupler_head1, CouplerHead coupler_head2, CouplerHead coupler_head3, double linear_density);
-    FourBarMechanism(const FourBarMechanism &other);
-    void rotate(double angle, double dt);
-    double getTotalEnergy();
-    double getAngle();
+    BasicFourBarMechanism(BasicCouplerHead<Scalar> coupler_head1, BasicCouplerHead<Scalar> coupler_head2, BasicCouplerHead<Scalar> coupler_head3, Scalar linear_density);
+    BasicFourBarMechanism(const BasicFourBarMechanism &other);
+    // Throws CirclesDoNotIntersect if the links can not be assembled at the angle
+    // The crank is taken to turn at a constant speed during dt, (angle - getAngle()) / dt
+    void rotate(Scalar angle, Scalar dt);
+    // Same as rotate, but reports an infeasible angle through the status instead of throwing
+    RotationStatus tryRotate(Scalar angle, Scalar dt);
+    // Moves the crank through start, start + step, ... up to end and calls visitor(mechanism, status) after every step
+    // Every step takes dt, so the crank turns at step / dt
+    // The crank direction is advanced by a rotation recurrence instead of calling cos and sin at every angle
+    template <typename Visitor>
+    void sweep(Scalar start, Scalar end, Scalar step, Scalar dt, Visitor visitor);
+    // Moves the crank from start to end with a step that follows the speed of the coupler head top points,
+    // calling visitor(mechanism, status) after every step. The crank turns at angular_speed (rad/s)
+    // A step is retried shorter until the chord it moves the top points along is at most half their clearance to the closest
+    // unpressed button pair, or a tenth of the smallest hitbox radius. Only the chord is measured, not the curved path
+    // between the two poses, so this is a heuristic: a pair the path only grazes can still be stepped over
+    // Far from the buttons the step grows up to max_step, it never goes below min_step
+    // The field can be a Field or a StaticField
+    template <typename FieldType, typename Visitor>
+    void adaptiveSweep(Scalar start, Scalar end, const FieldType &field, Scalar angular_speed, Visitor visitor, Scalar min_step = 1e-6, Scalar max_step = 0.2);
+    // Moves through the same angles as sweep, but follows both assembly branches at once from one circle intersection per step
+    // and calls visitor(angle, positive_tops, negative_tops) at every angle where the links can be assembled
+    // The branches are told apart by the sign of the assembly side, not by the distance to the previous pin joint,
+    // so the steps do not depend on each other. The mechanism itself is not moved
+    template <typename Visitor>
+    void sweepBothBranches(Scalar start, Scalar end, Scalar step, Visitor visitor) const;
+    // Coupler top path and pressed button pairs of both branches, indexed by AssemblyBranch
+    // The field can be a Field or a StaticField
+    template <typename FieldType>
+    std::array<BranchEvaluation, 2> evaluateBothBranches(Scalar start, Scalar end, Scalar step, const FieldType &field) const;
+    // Branch the mechanism is assembled on now
+    AssemblyBranch getAssemblyBranch() const;
+    // Kinetic and potential energy of all bodies. The velocities come from the crank angular speed and the
+    // derivatives of the loop closure equations, so the energy does not depend on the size of the last step
+    // Computed on the first call after a move, sweeps that never ask for it do not pay for it
+    // NaN at a dead point, where the coupler and the output link are aligned, see DEAD_POINT_SINE
+    Scalar getTotalEnergy();
+    // Angular speed of the crank (rad/s), the speeds of the other links follow from it
+    Scalar getCrankAngularSpeed() const;
+    void setCrankAngularSpeed(Scalar angular_speed);
+
+    LinkageType getLinkageType() const;
+    // Crank angles in [0, 2pi] at which the links can be assembled, sorted by start. Empty if there are none
+    // Intervals that wrap around 2pi are split in two
+    std::vector<AngleInterval> getFeasibleAngleIntervals() const;
+    // Two ranges of crank angles, each of them split in two if it wraps around 2pi
+    static constexpr int MAX_FEASIBLE_INTERVALS = 4;
+    // Same as above without allocating, returns the number of intervals written
+    int getFeasibleAngleIntervals(std::array<AngleInterval, MAX_FEASIBLE_INTERVALS> &intervals) const;
+    bool isAngleFeasible(double angle) const;
+    // False only if the pair can not be pressed at any crank angle. Each top point is fixed to the coupler, so it stays in
+    // an annulus around each ground pivot whose radii follow from the link lengths and its distances to the pins
+    // A few multiplies, meant to reject a mechanism before simulating it
+    bool canPressButtonPair(const ButtonPair &button_pair) const;
+    Scalar getAngle();
     std::string dumpState();
     std::string getDumpHeader();
-    const std::tuple<std::tuple<double, double>, std::tuple<double, double>> getInputLinkPositions() const;
-    const std::tuple<std::tuple<double, double>, std::tuple<double, double>> getCouplerLinkPositions() const;
-    const std::tuple<std::tuple<double, double>, std::tuple<double, double>> getOutputLinkPositions() const;
-    const std::tuple<std::tuple<double, double>, std::tuple<double, double>> getCouplerHeadTopPositions() const;
+    const std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> getInputLinkPositions() const;
+    const std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> getCouplerLinkPositions() const;
+    const std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> getOutputLinkPositions() const;
+    const std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> getCouplerHeadTopPositions() const;
 
-    static constexpr std::tuple<std::tuple<double, double>, std::tuple<double, double>> getLinkPositionsFromCouplers(
-        const std::tuple<std::tuple<double, double>, std::tuple<double, double>> coupler_pos_1,
-        const std::tuple<std::tuple<double, double>, std::tuple<double, double>> coupler_pos_2,
-        const std::tuple<std::tuple<double, double>, std::tuple<double, double>> coupler_pos_3);
+    static constexpr std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> getLinkPositionsFromCouplers(
+        const std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> coupler_pos_1,
+        const std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> coupler_pos_2,
+        const std::tuple<std::tuple<Scalar, Scalar>, std::tuple<Scalar, Scalar>> coupler_pos_3);
 
 private:
-    Link input_link;
-    Link coupler_link;
-    Link output_link;
-    CouplerHead coupler_head;
+    BasicLink<Scalar> input_link;
+    BasicLink<Scalar> coupler_link;
+    BasicLink<Scalar> output_link;
+    BasicCouplerHead<Scalar> coupler_head;
+
+    // Field works in double
+    static std::tuple<double, double> toDouble(const std::tuple<Scalar, Scalar> &point);
+    // Whether a top point, at its current position, can reach the square hitbox at any crank angle
+    bool canTopPointReach(const std::tuple<Scalar, Scalar> &top_point, double x, double y, double r) const;
+    // Cross product of the coupler link and the line from the crank pin to the output ground pivot, its sign tells the assembly branch
+    Scalar getAssemblySide() const;
+    // Top points of both branches with the crank at an angle whose cosine and sine are already known
+    // Empty if the links can not be assembled there
+    std::optional<std::tuple<TopPositions, TopPositions>> getBranchTopPositions(Scalar cos_angle, Scalar sin_angle) const;
+    // Moves the crank to an angle whose cosine and sine are already known, turning at angular_speed
+    RotationStatus moveCrankTo(Scalar angle, Scalar cos_angle, Scalar sin_angle, Scalar angular_speed);
+    // Sets the energy of every body from the crank angular speed at the current pose
+    void updateEnergies();
+    Scalar crank_angular_speed;
+    // Whether the energies of the bodies are older than the pose
+    bool energies_outdated;
+    // Number of sweep steps after which the crank direction is recomputed exactly, to stop rounding errors from accumulating
+    static constexpr int SWEEP_RESYNC_STEPS = 256;
+    // Cosine and sine of the count-th angle of a sweep, from those of the previous angle
+    static void advanceSweepDirection(long count, Scalar angle, Scalar cos_step, Scalar sin_step, Scalar &cos_angle, Scalar &sin_angle);
+    // Sine of the angle between the coupler and the output link below which the pose is taken as a dead point
+    // Away from the ends of the feasible range it stays above 1e-3, at the ends rounding leaves it below 1e-6
+    static constexpr double DEAD_POINT_SINE = 1e-4;
+    // Fraction of the smallest hitbox radius below which adaptiveSweep stops shrinking its step near a hitbox
+    static constexpr double ADAPTIVE_RESOLUTION = 0.1;
+
+    // Computed once from the link lengths. The linkage closes at crank angle theta when
+    // feasible_min_offset <= |theta - feasible_center| <= feasible_max_offset (wrapped to [-pi, pi])
+    void computeFeasibleAngles();
+    double feasible_center;
+    double feasible_min_offset;
+    double feasible_max_offset;
+
     static constexpr double GRAVITY = 9.80665;
+    static constexpr double PI = 3.14159265358979323846;
 };
+
+using FourBarMechanism = BasicFourBarMechanism<double>;
+
+template <typename Scalar>
+template <typename Visitor>
+void BasicFourBarMechanism<Scalar>::sweep(Scalar start, Scalar end, Scalar step, Scalar dt, Visitor visitor)
+{
+    using std::cos;
+    using std::sin;
+    if (!(step > 0))
+    {
+        return;
+    }
+    // Rotating (cos, sin) of the current angle by the step gives (cos, sin) of the next one
+    Scalar cos_step = cos(step);
+    Scalar sin_step = sin(step);
+    Scalar cos_angle = 0;
+    Scalar sin_angle = 0;
+    for (long count = 0; start + count * step <= end; count++)
+    {
+        Scalar angle = start + count * step;
+        advanceSweepDirection(count, angle, cos_step, sin_step, cos_angle, sin_angle);
+        RotationStatus status = moveCrankTo(angle, cos_angle, sin_angle, step / dt);
+        visitor(*this, status);
+    }
+}
+
+template <typename Scalar>
+template <typename Visitor>
+void BasicFourBarMechanism<Scalar>::sweepBothBranches(Scalar start, Scalar end, Scalar step, Visitor visitor) const
+{
+    using std::cos;
+    using std::sin;
+    if (!(step > 0))
+    {
+        return;
+    }
+    Scalar cos_step = cos(step);
+    Scalar sin_step = sin(step);
+    Scalar cos_angle = 0;
+    Scalar sin_angle = 0;
+    for (long count = 0; start + count * step <= end; count++)
+    {
+        Scalar angle = start + count * step;
+        advanceSweepDirection(count, angle, cos_step, sin_step, cos_angle, sin_angle);
+        auto branches = getBranchTopPositions(cos_angle, sin_angle);
+        if (branches)
+        {
+            visitor(angle, std::get<0>(branches.value()), std::get<1>(branches.value()));
+        }
+    }
+}
+
+template <typename Scalar>
+template <typename FieldType>
+std::array<BranchEvaluation, 2> BasicFourBarMechanism<Scalar>::evaluateBothBranches(Scalar start, Scalar end, Scalar step, const FieldType &field) const
+{
+    std::array<BranchEvaluation, 2> evaluations;
+    int button_pair_count = field.getButtonPairCount();
+    for (BranchEvaluation &evaluation : evaluations)
+    {
+        evaluation.pressed_button_pairs.assign(button_pair_count, false);
+        evaluation.buttons_pressed = 0;
+    }
+    auto record = [&](BranchEvaluation &evaluation, const TopPositions &tops)
+    {
+        auto crank_top = toDouble(std::get<0>(tops));
+        auto output_top = toDouble(std::get<1>(tops));
+        evaluation.coupler_top_path.push_back(std::make_tuple(crank_top, output_top));
+        int button_index = field.getButtonPairPressedIndex(crank_top, output_top);
+        if (button_index != -1 && !evaluation.pressed_button_pairs[button_index])
+        {
+            evaluation.pressed_button_pairs[button_index] = true;
+            evaluation.buttons_pressed++;
+        }
+    };
+    sweepBothBranches(start, end, step, [&](Scalar, const TopPositions &positive_tops, const TopPositions &negative_tops)
+                      {
+        record(evaluations[static_cast<int>(AssemblyBranch::Positive)], positive_tops);
+        record(evaluations[static_cast<int>(AssemblyBranch::Negative)], negative_tops); });
+    return evaluations;
+}
+
+template <typename Scalar>
+template <typename FieldType, typename Visitor>
+void BasicFourBarMechanism<Scalar>::adaptiveSweep(Scalar start, Scalar end, const FieldType &field, Scalar angular_speed, Visitor visitor, Scalar min_step, Scalar max_step)
+{
+    using std::cos;
+    using std::hypot;
+    using std::sin;
+    // Distances are compared in double, like the field
+    double resolution = ADAPTIVE_RESOLUTION * field.getSmallestHitboxRadius();
+    Scalar angle = start;
+    RotationStatus status = moveCrankTo(angle, cos(angle), sin(angle), angular_speed);
+    visitor(*this, status);
+    // A conservative first guess, it grows as soon as the speed of the top points is known
+    Scalar step = min_step;
+    while (angle < end)
+    {
+        auto [old_crank_top, old_output_top] = getCouplerHeadTopPositions();
+        // How far the top points may go before a hitbox could be entered and left again between two samples
+        double allowed = std::max(field.getClearance(toDouble(old_crank_top), toDouble(old_output_top)), resolution);
+        Scalar next_angle = std::min(angle + step, end);
+        Scalar taken_step = next_angle - angle;
+        BasicFourBarMechanism previous = *this;
+        status = moveCrankTo(next_angle, cos(next_angle), sin(next_angle), angular_speed);
+        if (status != RotationStatus::Moved)
+        {
+            // Only happens at the ends of the feasible range
+            visitor(*this, status);
+            angle = next_angle;
+            step = min_step;
+            continue;
+        }
+        auto [crank_top, output_top] = getCouplerHeadTopPositions();
+        // Inside a feasible range the coupler never crosses the line from the crank pin to the output ground pivot,
+        // so a change of side means the closest pin joint was on the other assembly branch
+        bool branch_jumped = (getAssemblySide() > 0) != (previous.getAssemblySide() > 0);
+        double displacement = static_cast<double>(std::max(hypot(std::get<0>(crank_top) - std::get<0>(old_crank_top), std::get<1>(crank_top) - std::get<1>(old_crank_top)),
+                                                           hypot(std::get<0>(output_top) - std::get<0>(old_output_top), std::get<1>(output_top) - std::get<1>(old_output_top))));
+        // The chord is shorter than the path the points followed, half of the allowance is kept for the curvature
+        if ((branch_jumped || 2 * displacement > allowed) && step > min_step)
+        {
+            // Too far, undo and retry with the step the measured speed allows
+            *this = previous;
+            step = std::max(min_step, branch_jumped ? taken_step / 4 : std::min(taken_step / 2, Scalar(0.4 * allowed / displacement) * taken_step));
+            continue;
+        }
+        visitor(*this, status);
+        angle = next_angle;
+        // Next step from the speed of the top points and the clearance at the new pose, with a margin for acceleration
+        double speed = displacement / static_cast<double>(taken_step);
+        double next_allowed = std::max(field.getClearance(toDouble(crank_top), toDouble(output_top)), resolution);
+        step = speed > 0 ? Scalar(0.4 * next_allowed / speed) : max_step;
+        step = std::max(min_step, std::min(max_step, std::min(step, 2 * taken_step)));
+    }
+}
 #endif
\ No newline at end of file
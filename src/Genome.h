@@ -0,0 +1,10 @@
+#ifndef GENOME_H
+#define GENOME_H
+
+#include <array>
+
+// The six points of a mechanism as x, y pairs, in the order of GenerationLimits: input ground, input coupler,
+// coupler output, output ground, coupler top input and coupler top output
+// The genetic algorithm works on these 12 doubles, a mechanism is only built from them to be evaluated
+using Genome = std::array<double, 12>;
+#endif
\ No newline at end of file
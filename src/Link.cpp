@@ -1,9 +1,19 @@
 #include <cmath>
 #include "Link.h"
+#include "Dual.h"
 
-Link::Link() {}
+// Unqualified math calls also find the overloads of the Dual scalar type
+using std::atan2;
+using std::cos;
+using std::pow;
+using std::sin;
+using std::sqrt;
 
-Link::Link(Link &link)
+template <typename Scalar>
+BasicLink<Scalar>::BasicLink() {}
+
+template <typename Scalar>
+BasicLink<Scalar>::BasicLink(BasicLink &link)
 {
     this->past_link = link.past_link;
     this->next_link = link.next_link;
@@ -13,9 +23,11 @@ Link::Link(Link &link)
     this->im = link.im;
     this->length = link.length;
     this->angle = link.angle;
+    this->energy = link.energy;
     this->is_ground = link.is_ground;
 }
-Link::Link(std::tuple<double, double> pos, std::tuple<double, double> pos2, double linear_density)
+template <typename Scalar>
+BasicLink<Scalar>::BasicLink(std::tuple<Scalar, Scalar> pos, std::tuple<Scalar, Scalar> pos2, Scalar linear_density)
 {
     position = pos;
     position2 = pos2;
@@ -24,83 +36,87 @@ Link::Link(std::tuple<double, double> pos, std::tuple<double, double> pos2, doub
     angle = atan2(y2 - y, x2 - x);
     length = sqrt(pow(x2 - x, 2) + pow(y2 - y, 2));
     m = linear_density * length;
-    im = (m * std::pow(length, 2) / 12.0);
+    im = (m * pow(length, 2) / 12.0);
     is_ground = false;
 }
 
-void Link::setTheta(double theta_value, double dt)
+template <typename Scalar>
+void BasicLink<Scalar>::setTheta(Scalar theta_value)
 {
-    auto [x, y] = position;
-    auto [x2, y2] = position2;
-    double cm_x = (x + x2) / 2.0;
-    double cm_y = (y + y2) / 2.0;
-
-    double x2n = x + this->length * cos(theta_value);
-    double y2n = y + this->length * sin(theta_value);
-
-    double cm_xn = (x + x2n) / 2.0;
-    double cm_yn = (y + y2n) / 2.0;
+    setTheta(theta_value, cos(theta_value), sin(theta_value));
+}
 
-    double speed = (std::sqrt(std::pow(cm_xn - cm_x, 2) + std::pow(cm_yn - cm_y, 2))) / dt;
-    double angular_speed = (theta_value - this->angle) / dt;
-    setEnergy(speed, angular_speed);
+template <typename Scalar>
+void BasicLink<Scalar>::setTheta(Scalar theta_value, Scalar cos_theta, Scalar sin_theta)
+{
+    auto [x, y] = position;
+    Scalar x2n = x + this->length * cos_theta;
+    Scalar y2n = y + this->length * sin_theta;
 
     this->angle = theta_value;
     this->position2 = std::make_tuple(x2n, y2n);
 }
-double Link::getTheta()
+template <typename Scalar>
+Scalar BasicLink<Scalar>::getTheta() const
 {
     return this->angle;
 }
 
-void Link::setPos(std::tuple<double, double> pos_value, double dt)
+template <typename Scalar>
+Scalar BasicLink<Scalar>::getRotationTo(std::tuple<Scalar, Scalar> pos_value, std::tuple<Scalar, Scalar> pos_value2) const
 {
     auto [x, y] = this->position;
     auto [x2, y2] = this->position2;
     auto [xn, yn] = pos_value;
-    double length_new = std::sqrt(std::pow(xn - x2, 2) + std::pow(yn - y2, 2));
-    double angle_new = std::atan2(y2 - yn, x2 - xn);
+    auto [xn2, yn2] = pos_value2;
+    // Angle between the old and the new direction of the link
+    Scalar cross = (x2 - x) * (yn2 - yn) - (y2 - y) * (xn2 - xn);
+    Scalar dot = (x2 - x) * (xn2 - xn) + (y2 - y) * (yn2 - yn);
+    return atan2(cross, dot);
+}
 
-    double cm_x = (x + x2) / 2.0;
-    double cm_y = (y + y2) / 2.0;
-    double cm_xn = (xn + x2) / 2.0;
-    double cm_yn = (yn + y2) / 2.0;
-    double speed = (std::sqrt(std::pow(cm_xn - cm_x, 2) + std::pow(cm_yn - cm_y, 2))) / dt;
-    double angular_speed = (angle_new - this->angle) / dt;
-    setEnergy(speed, angular_speed);
+template <typename Scalar>
+void BasicLink<Scalar>::setPos(std::tuple<Scalar, Scalar> pos_value)
+{
+    setPos(pos_value, this->angle + getRotationTo(pos_value, this->position2));
+}
+
+template <typename Scalar>
+void BasicLink<Scalar>::setPos(std::tuple<Scalar, Scalar> pos_value, Scalar angle_new)
+{
+    auto [x2, y2] = this->position2;
+    auto [xn, yn] = pos_value;
+    Scalar length_new = sqrt(pow(xn - x2, 2) + pow(yn - y2, 2));
 
     this->position = pos_value;
     this->angle = angle_new;
     this->length = length_new;
 }
 
-const std::tuple<double, double> Link::getPos() const
+template <typename Scalar>
+const std::tuple<Scalar, Scalar> BasicLink<Scalar>::getPos() const
 {
     return this->position;
 }
 
-const std::tuple<double, double> Link::getPos2() const
+template <typename Scalar>
+const std::tuple<Scalar, Scalar> BasicLink<Scalar>::getPos2() const
 {
     return this->position2;
 }
-void Link::setTwoPositions(std::tuple<double, double> pos_value, std::tuple<double, double> pos_value2, double dt)
+template <typename Scalar>
+void BasicLink<Scalar>::setTwoPositions(std::tuple<Scalar, Scalar> pos_value, std::tuple<Scalar, Scalar> pos_value2)
+{
+    setTwoPositions(pos_value, pos_value2, this->angle + getRotationTo(pos_value, pos_value2));
+}
+
+template <typename Scalar>
+void BasicLink<Scalar>::setTwoPositions(std::tuple<Scalar, Scalar> pos_value, std::tuple<Scalar, Scalar> pos_value2, Scalar angle_new)
 {
-    auto [x, y] = this->position;
-    auto [x2, y2] = this->position2;
     auto [xn, yn] = pos_value;
     auto [xn2, yn2] = pos_value2;
 
-    double length_new = std::sqrt(std::pow(xn - xn2, 2) + std::pow(yn - yn2, 2));
-    double angle_new = std::atan2(yn2 - yn, xn2 - xn);
-
-    double cm_x = (x + x2) / 2.0;
-    double cm_y = (y + y2) / 2.0;
-    double cm_xn = (xn + xn2) / 2.0;
-    double cm_yn = (yn + yn2) / 2.0;
-
-    double speed = (std::sqrt(std::pow(cm_xn - cm_x, 2) + std::pow(cm_yn - cm_y, 2))) / dt;
-    double angular_speed = (angle_new - this->angle) / dt;
-    setEnergy(speed, angular_speed);
+    Scalar length_new = sqrt(pow(xn - xn2, 2) + pow(yn - yn2, 2));
 
     this->position = pos_value;
     this->position2 = pos_value2;
@@ -108,28 +124,37 @@ void Link::setTwoPositions(std::tuple<double, double> pos_value, std::tuple<doub
     this->length = length_new;
 }
 
-double Link::getL()
+template <typename Scalar>
+Scalar BasicLink<Scalar>::getL() const
 {
     return this->length;
 }
 
-double Link::getM()
+template <typename Scalar>
+Scalar BasicLink<Scalar>::getM() const
 {
     return this->m;
 }
 
-double Link::getIM()
+template <typename Scalar>
+Scalar BasicLink<Scalar>::getIM() const
 {
     return this->im;
 }
 
-void Link::setEnergy(double speed, double angular_speed)
+template <typename Scalar>
+void BasicLink<Scalar>::setEnergy(Scalar speed, Scalar angular_speed)
 {
-    double y_coord = (std::get<1>(position2) + std::get<0>(position)) / 2;
-    energy = (m * std::pow(speed, 2) / 2) + (im * std::pow(angular_speed, 2) / 2) + (m * GRAVITY * y_coord);
+    Scalar y_coord = (std::get<1>(position2) + std::get<1>(position)) / 2;
+    energy = (m * pow(speed, 2) / 2) + (im * pow(angular_speed, 2) / 2) + (m * GRAVITY * y_coord);
 }
 
-double Link::getEnergy()
+template <typename Scalar>
+Scalar BasicLink<Scalar>::getEnergy()
 {
     return this->energy;
 }
+
+template class BasicLink<double>;
+template class BasicLink<float>;
+template class BasicLink<Dual<double>>;
\ No newline at end of file
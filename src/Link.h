@@ -2,59 +2,75 @@
 #define LINK_H
 #include <tuple>
 
-class Link
+// Generic over the scalar type, instantiated for double (Link), float and Dual<double>
+template <typename Scalar = double>
+class BasicLink
 {
 public:
-    Link();
-    Link(Link &link);
+    BasicLink();
+    BasicLink(BasicLink &link);
     // Regular Link
-    Link(Link &past_link, double mass, double im, double length);
+    BasicLink(BasicLink &past_link, Scalar mass, Scalar im, Scalar length);
     // Regular Link
-    Link(std::tuple<double, double> pos, std::tuple<double, double> pos2, double linear_density);
+    BasicLink(std::tuple<Scalar, Scalar> pos, std::tuple<Scalar, Scalar> pos2, Scalar linear_density);
     // Regular Link
-    Link(double mass, double im, double length);
+    BasicLink(Scalar mass, Scalar im, Scalar length);
     // Ground Link
 
-    void setPastLink(Link &past_link);
-    Link &getPastLink();
-    void setNextLink(Link &next_link);
-    Link &getNextLink();
+    void setPastLink(BasicLink &past_link);
+    BasicLink &getPastLink();
+    void setNextLink(BasicLink &next_link);
+    BasicLink &getNextLink();
 
-    void setIM(double im_value);
-    double getIM();
-    void setM(double m_value);
-    double getM();
-    void setL(double l_value);
-    double getL();
+    void setIM(Scalar im_value);
+    Scalar getIM() const;
+    void setM(Scalar m_value);
+    Scalar getM() const;
+    void setL(Scalar l_value);
+    Scalar getL() const;
 
-    void setTheta(double theta_value, double dt);
-    double getTheta();
+    // The setters only move the link, the energy is set from the velocities with setEnergy
+    void setTheta(Scalar theta_value);
+    // Same as setTheta, with the cosine and sine of the angle already known
+    void setTheta(Scalar theta_value, Scalar cos_theta, Scalar sin_theta);
+    // The angle is tracked continuously as the link turns, it is not wrapped to [-pi, pi]
+    Scalar getTheta() const;
     // Pos always refer to the closest connection to the crank link (on the left usually)
-    void setPos(std::tuple<double, double> pos_value, double dt);
-    const std::tuple<double, double> getPos() const;
+    void setPos(std::tuple<Scalar, Scalar> pos_value);
+    // Same as setPos, with the new angle of the link already known
+    void setPos(std::tuple<Scalar, Scalar> pos_value, Scalar theta_value);
+    const std::tuple<Scalar, Scalar> getPos() const;
 
     // Other joint (the right side)
-    void setPos2(std::tuple<double, double> pos_value, double dt);
-    const std::tuple<double, double> getPos2() const;
+    void setPos2(std::tuple<Scalar, Scalar> pos_value, Scalar dt);
+    const std::tuple<Scalar, Scalar> getPos2() const;
 
     // Set both positions
-    void setTwoPositions(std::tuple<double, double> pos_value, std::tuple<double, double> pos_value2, double dt);
+    void setTwoPositions(std::tuple<Scalar, Scalar> pos_value, std::tuple<Scalar, Scalar> pos_value2);
+    // Same as setTwoPositions, with the new angle of the link already known
+    void setTwoPositions(std::tuple<Scalar, Scalar> pos_value, std::tuple<Scalar, Scalar> pos_value2, Scalar theta_value);
 
-    void setEnergy(double speed, double angular_speed);
-    double getEnergy();
+    // Angle the link would turn by to point from pos_value to pos_value2
+    Scalar getRotationTo(std::tuple<Scalar, Scalar> pos_value, std::tuple<Scalar, Scalar> pos_value2) const;
+
+    // Kinetic energy from the speed of the center of mass and the angular speed, plus the potential energy at the current position
+    void setEnergy(Scalar speed, Scalar angular_speed);
+    Scalar getEnergy();
 
 private:
-    Link *past_link;
-    Link *next_link;
-
-    std::tuple<double, double> position;
-    std::tuple<double, double> position2;
-    double m;
-    double im;
-    double length;
-    double angle;
-    double energy;
+    BasicLink *past_link;
+    BasicLink *next_link;
+
+    std::tuple<Scalar, Scalar> position;
+    std::tuple<Scalar, Scalar> position2;
+    Scalar m;
+    Scalar im;
+    Scalar length;
+    Scalar angle;
+    Scalar energy;
     static constexpr double GRAVITY = 9.80665;
     bool is_ground;
 };
+
+using Link = BasicLink<double>;
 #endif
\ No newline at end of file
@@ -0,0 +1,352 @@
+#include <cmath>
+#include <algorithm>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#include "MechanismBatch.h"
+
+MechanismBatch::MechanismBatch() {}
+
+MechanismBatch::MechanismBatch(const std::vector<FourBarMechanism> &mechanisms)
+{
+    reserve(mechanisms.size());
+    for (const FourBarMechanism &mechanism : mechanisms)
+    {
+        addMechanism(mechanism);
+    }
+}
+
+void MechanismBatch::reserve(int capacity)
+{
+    for (std::vector<double> *column : {&input_ground_x, &input_ground_y, &output_ground_x, &output_ground_y,
+                                        &input_length, &coupler_length, &output_length,
+                                        &crank_top_along, &crank_top_across, &output_top_along, &output_top_across,
+                                        &crank_pin_x, &crank_pin_y, &output_pin_x, &output_pin_y,
+                                        &crank_top_x, &crank_top_y, &output_top_x, &output_top_y})
+    {
+        column->reserve(capacity);
+    }
+    feasible.reserve(capacity);
+}
+
+void MechanismBatch::addMechanism(const FourBarMechanism &mechanism)
+{
+    auto [input_ground, crank_pin] = mechanism.getInputLinkPositions();
+    auto [output_pin, output_ground] = mechanism.getOutputLinkPositions();
+    auto [crank_top, output_top] = mechanism.getCouplerHeadTopPositions();
+    auto [xg, yg] = input_ground;
+    auto [xc, yc] = crank_pin;
+    auto [xo, yo] = output_pin;
+    auto [xog, yog] = output_ground;
+    auto [xct, yct] = crank_top;
+    auto [xot, yot] = output_top;
+
+    input_ground_x.push_back(xg);
+    input_ground_y.push_back(yg);
+    output_ground_x.push_back(xog);
+    output_ground_y.push_back(yog);
+
+    double coupler = std::sqrt((xo - xc) * (xo - xc) + (yo - yc) * (yo - yc));
+    input_length.push_back(std::sqrt((xc - xg) * (xc - xg) + (yc - yg) * (yc - yg)));
+    coupler_length.push_back(coupler);
+    output_length.push_back(std::sqrt((xog - xo) * (xog - xo) + (yog - yo) * (yog - yo)));
+
+    // Unit vector along the coupler and its normal
+    double ux = (xo - xc) / coupler;
+    double uy = (yo - yc) / coupler;
+    crank_top_along.push_back((xct - xc) * ux + (yct - yc) * uy);
+    crank_top_across.push_back(-(xct - xc) * uy + (yct - yc) * ux);
+    output_top_along.push_back((xot - xc) * ux + (yot - yc) * uy);
+    output_top_across.push_back(-(xot - xc) * uy + (yot - yc) * ux);
+
+    crank_pin_x.push_back(xc);
+    crank_pin_y.push_back(yc);
+    output_pin_x.push_back(xo);
+    output_pin_y.push_back(yo);
+    crank_top_x.push_back(xct);
+    crank_top_y.push_back(yct);
+    output_top_x.push_back(xot);
+    output_top_y.push_back(yot);
+    feasible.push_back(1);
+}
+
+int MechanismBatch::size() const
+{
+    return input_length.size();
+}
+
+int MechanismBatch::rotateAll(double angle)
+{
+    // Every crank turns to the same angle, so the trigonometry is shared by the whole batch
+    double cos_angle = std::cos(angle);
+    double sin_angle = std::sin(angle);
+    int count = size();
+    int begin = 0;
+    int feasible_count = 0;
+#if defined(__AVX512F__)
+    int vector_end = count - count % 8;
+    feasible_count += rotateRangeAvx512(0, vector_end, cos_angle, sin_angle);
+    begin = vector_end;
+#elif defined(__AVX2__)
+    int vector_end = count - count % 4;
+    feasible_count += rotateRangeAvx2(0, vector_end, cos_angle, sin_angle);
+    begin = vector_end;
+#endif
+    feasible_count += rotateRange(begin, count, cos_angle, sin_angle);
+    return feasible_count;
+}
+
+// Scalar version of FourBarMechanism::rotate, one mechanism at a time
+int MechanismBatch::rotateRange(int begin, int end, double cos_angle, double sin_angle)
+{
+    int feasible_count = 0;
+    for (int i = begin; i < end; i++)
+    {
+        // The right end of the crank bar
+        double x1 = input_ground_x[i] + input_length[i] * cos_angle;
+        double y1 = input_ground_y[i] + input_length[i] * sin_angle;
+        double x2 = output_ground_x[i];
+        double y2 = output_ground_y[i];
+        double r1 = coupler_length[i];
+        double r2 = output_length[i];
+
+        double centerdx = x1 - x2;
+        double centerdy = y1 - y2;
+        double R = std::sqrt(centerdx * centerdx + centerdy * centerdy);
+        if (!(std::abs(r1 - r2) <= R && R <= r1 + r2))
+        {
+            feasible[i] = 0;
+            continue;
+        }
+        double R2 = R * R;
+        double R4 = R2 * R2;
+        double a = (r1 * r1 - r2 * r2) / (2 * R2);
+        double r2r2 = (r1 * r1 - r2 * r2);
+        double c = std::sqrt(std::max(0.0, 2 * (r1 * r1 + r2 * r2) / R2 - (r2r2 * r2r2) / R4 - 1));
+
+        double fx = (x1 + x2) / 2 + a * (x2 - x1);
+        double gx = c * (y2 - y1) / 2;
+        double fy = (y1 + y2) / 2 + a * (y2 - y1);
+        double gy = c * (x1 - x2) / 2;
+
+        // Keeps the solution closest to the previous output pin
+        double dx1 = fx + gx - output_pin_x[i];
+        double dy1 = fy + gy - output_pin_y[i];
+        double dx2 = fx - gx - output_pin_x[i];
+        double dy2 = fy - gy - output_pin_y[i];
+        double xo = fx - gx;
+        double yo = fy - gy;
+        if (dx1 * dx1 + dy1 * dy1 < dx2 * dx2 + dy2 * dy2)
+        {
+            xo = fx + gx;
+            yo = fy + gy;
+        }
+
+        double coupler = std::sqrt((xo - x1) * (xo - x1) + (yo - y1) * (yo - y1));
+        double ux = (xo - x1) / coupler;
+        double uy = (yo - y1) / coupler;
+
+        crank_pin_x[i] = x1;
+        crank_pin_y[i] = y1;
+        output_pin_x[i] = xo;
+        output_pin_y[i] = yo;
+        crank_top_x[i] = x1 + crank_top_along[i] * ux - crank_top_across[i] * uy;
+        crank_top_y[i] = y1 + crank_top_along[i] * uy + crank_top_across[i] * ux;
+        output_top_x[i] = x1 + output_top_along[i] * ux - output_top_across[i] * uy;
+        output_top_y[i] = y1 + output_top_along[i] * uy + output_top_across[i] * ux;
+        feasible[i] = 1;
+        feasible_count++;
+    }
+    return feasible_count;
+}
+
+#if defined(__AVX512F__)
+// Same computation as rotateRange, 8 mechanisms per iteration. end - begin must be a multiple of 8
+int MechanismBatch::rotateRangeAvx512(int begin, int end, double cos_angle, double sin_angle)
+{
+    const __m512d cos_v = _mm512_set1_pd(cos_angle);
+    const __m512d sin_v = _mm512_set1_pd(sin_angle);
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d two = _mm512_set1_pd(2.0);
+    const __m512d half = _mm512_set1_pd(0.5);
+    const __mmask8 all_lanes = 0xFF;
+    int feasible_count = 0;
+    for (int i = begin; i < end; i += 8)
+    {
+        __m512d length = _mm512_loadu_pd(&input_length[i]);
+        __m512d x1 = _mm512_add_pd(_mm512_loadu_pd(&input_ground_x[i]), _mm512_mul_pd(length, cos_v));
+        __m512d y1 = _mm512_add_pd(_mm512_loadu_pd(&input_ground_y[i]), _mm512_mul_pd(length, sin_v));
+        __m512d x2 = _mm512_loadu_pd(&output_ground_x[i]);
+        __m512d y2 = _mm512_loadu_pd(&output_ground_y[i]);
+        __m512d r1 = _mm512_loadu_pd(&coupler_length[i]);
+        __m512d r2 = _mm512_loadu_pd(&output_length[i]);
+
+        __m512d centerdx = _mm512_sub_pd(x1, x2);
+        __m512d centerdy = _mm512_sub_pd(y1, y2);
+        __m512d R2 = _mm512_add_pd(_mm512_mul_pd(centerdx, centerdx), _mm512_mul_pd(centerdy, centerdy));
+        __m512d R = _mm512_maskz_sqrt_pd(all_lanes, R2);
+        __mmask8 ok = _mm512_cmp_pd_mask(_mm512_abs_pd(_mm512_sub_pd(r1, r2)), R, _CMP_LE_OQ) &
+                      _mm512_cmp_pd_mask(R, _mm512_add_pd(r1, r2), _CMP_LE_OQ);
+
+        R2 = _mm512_mul_pd(R, R);
+        __m512d R4 = _mm512_mul_pd(R2, R2);
+        __m512d r2r2 = _mm512_sub_pd(_mm512_mul_pd(r1, r1), _mm512_mul_pd(r2, r2));
+        __m512d a = _mm512_div_pd(r2r2, _mm512_mul_pd(two, R2));
+        __m512d c = _mm512_maskz_sqrt_pd(all_lanes, _mm512_maskz_max_pd(all_lanes, _mm512_setzero_pd(), _mm512_sub_pd(_mm512_sub_pd(_mm512_div_pd(_mm512_mul_pd(two, _mm512_add_pd(_mm512_mul_pd(r1, r1), _mm512_mul_pd(r2, r2))), R2),
+                                                               _mm512_div_pd(_mm512_mul_pd(r2r2, r2r2), R4)),
+                                                 one)));
+
+        __m512d fx = _mm512_add_pd(_mm512_mul_pd(_mm512_add_pd(x1, x2), half), _mm512_mul_pd(a, _mm512_sub_pd(x2, x1)));
+        __m512d gx = _mm512_mul_pd(_mm512_mul_pd(c, _mm512_sub_pd(y2, y1)), half);
+        __m512d fy = _mm512_add_pd(_mm512_mul_pd(_mm512_add_pd(y1, y2), half), _mm512_mul_pd(a, _mm512_sub_pd(y2, y1)));
+        __m512d gy = _mm512_mul_pd(_mm512_mul_pd(c, _mm512_sub_pd(x1, x2)), half);
+
+        __m512d past_x = _mm512_loadu_pd(&output_pin_x[i]);
+        __m512d past_y = _mm512_loadu_pd(&output_pin_y[i]);
+        __m512d dx1 = _mm512_sub_pd(_mm512_add_pd(fx, gx), past_x);
+        __m512d dy1 = _mm512_sub_pd(_mm512_add_pd(fy, gy), past_y);
+        __m512d dx2 = _mm512_sub_pd(_mm512_sub_pd(fx, gx), past_x);
+        __m512d dy2 = _mm512_sub_pd(_mm512_sub_pd(fy, gy), past_y);
+        __mmask8 first = _mm512_cmp_pd_mask(_mm512_add_pd(_mm512_mul_pd(dx1, dx1), _mm512_mul_pd(dy1, dy1)),
+                                            _mm512_add_pd(_mm512_mul_pd(dx2, dx2), _mm512_mul_pd(dy2, dy2)), _CMP_LT_OQ);
+        __m512d xo = _mm512_mask_blend_pd(first, _mm512_sub_pd(fx, gx), _mm512_add_pd(fx, gx));
+        __m512d yo = _mm512_mask_blend_pd(first, _mm512_sub_pd(fy, gy), _mm512_add_pd(fy, gy));
+
+        __m512d dxo = _mm512_sub_pd(xo, x1);
+        __m512d dyo = _mm512_sub_pd(yo, y1);
+        __m512d coupler = _mm512_maskz_sqrt_pd(all_lanes, _mm512_add_pd(_mm512_mul_pd(dxo, dxo), _mm512_mul_pd(dyo, dyo)));
+        __m512d ux = _mm512_div_pd(dxo, coupler);
+        __m512d uy = _mm512_div_pd(dyo, coupler);
+
+        __m512d ct_along = _mm512_loadu_pd(&crank_top_along[i]);
+        __m512d ct_across = _mm512_loadu_pd(&crank_top_across[i]);
+        __m512d ot_along = _mm512_loadu_pd(&output_top_along[i]);
+        __m512d ot_across = _mm512_loadu_pd(&output_top_across[i]);
+        __m512d xct = _mm512_sub_pd(_mm512_add_pd(x1, _mm512_mul_pd(ct_along, ux)), _mm512_mul_pd(ct_across, uy));
+        __m512d yct = _mm512_add_pd(_mm512_add_pd(y1, _mm512_mul_pd(ct_along, uy)), _mm512_mul_pd(ct_across, ux));
+        __m512d xot = _mm512_sub_pd(_mm512_add_pd(x1, _mm512_mul_pd(ot_along, ux)), _mm512_mul_pd(ot_across, uy));
+        __m512d yot = _mm512_add_pd(_mm512_add_pd(y1, _mm512_mul_pd(ot_along, uy)), _mm512_mul_pd(ot_across, ux));
+
+        // Infeasible lanes keep their previous pose
+        _mm512_mask_storeu_pd(&crank_pin_x[i], ok, x1);
+        _mm512_mask_storeu_pd(&crank_pin_y[i], ok, y1);
+        _mm512_mask_storeu_pd(&output_pin_x[i], ok, xo);
+        _mm512_mask_storeu_pd(&output_pin_y[i], ok, yo);
+        _mm512_mask_storeu_pd(&crank_top_x[i], ok, xct);
+        _mm512_mask_storeu_pd(&crank_top_y[i], ok, yct);
+        _mm512_mask_storeu_pd(&output_top_x[i], ok, xot);
+        _mm512_mask_storeu_pd(&output_top_y[i], ok, yot);
+        for (int lane = 0; lane < 8; lane++)
+        {
+            feasible[i + lane] = (ok >> lane) & 1;
+        }
+        feasible_count += __builtin_popcount(ok);
+    }
+    return feasible_count;
+}
+#elif defined(__AVX2__)
+// Same computation as rotateRange, 4 mechanisms per iteration. end - begin must be a multiple of 4
+int MechanismBatch::rotateRangeAvx2(int begin, int end, double cos_angle, double sin_angle)
+{
+    const __m256d cos_v = _mm256_set1_pd(cos_angle);
+    const __m256d sin_v = _mm256_set1_pd(sin_angle);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d sign_bit = _mm256_set1_pd(-0.0);
+    int feasible_count = 0;
+    for (int i = begin; i < end; i += 4)
+    {
+        __m256d length = _mm256_loadu_pd(&input_length[i]);
+        __m256d x1 = _mm256_add_pd(_mm256_loadu_pd(&input_ground_x[i]), _mm256_mul_pd(length, cos_v));
+        __m256d y1 = _mm256_add_pd(_mm256_loadu_pd(&input_ground_y[i]), _mm256_mul_pd(length, sin_v));
+        __m256d x2 = _mm256_loadu_pd(&output_ground_x[i]);
+        __m256d y2 = _mm256_loadu_pd(&output_ground_y[i]);
+        __m256d r1 = _mm256_loadu_pd(&coupler_length[i]);
+        __m256d r2 = _mm256_loadu_pd(&output_length[i]);
+
+        __m256d centerdx = _mm256_sub_pd(x1, x2);
+        __m256d centerdy = _mm256_sub_pd(y1, y2);
+        __m256d R = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(centerdx, centerdx), _mm256_mul_pd(centerdy, centerdy)));
+        __m256d ok = _mm256_and_pd(_mm256_cmp_pd(_mm256_andnot_pd(sign_bit, _mm256_sub_pd(r1, r2)), R, _CMP_LE_OQ),
+                                   _mm256_cmp_pd(R, _mm256_add_pd(r1, r2), _CMP_LE_OQ));
+
+        __m256d R2 = _mm256_mul_pd(R, R);
+        __m256d R4 = _mm256_mul_pd(R2, R2);
+        __m256d r2r2 = _mm256_sub_pd(_mm256_mul_pd(r1, r1), _mm256_mul_pd(r2, r2));
+        __m256d a = _mm256_div_pd(r2r2, _mm256_mul_pd(two, R2));
+        __m256d c = _mm256_sqrt_pd(_mm256_max_pd(_mm256_setzero_pd(), _mm256_sub_pd(_mm256_sub_pd(_mm256_div_pd(_mm256_mul_pd(two, _mm256_add_pd(_mm256_mul_pd(r1, r1), _mm256_mul_pd(r2, r2))), R2),
+                                                               _mm256_div_pd(_mm256_mul_pd(r2r2, r2r2), R4)),
+                                                 one)));
+
+        __m256d fx = _mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(x1, x2), half), _mm256_mul_pd(a, _mm256_sub_pd(x2, x1)));
+        __m256d gx = _mm256_mul_pd(_mm256_mul_pd(c, _mm256_sub_pd(y2, y1)), half);
+        __m256d fy = _mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(y1, y2), half), _mm256_mul_pd(a, _mm256_sub_pd(y2, y1)));
+        __m256d gy = _mm256_mul_pd(_mm256_mul_pd(c, _mm256_sub_pd(x1, x2)), half);
+
+        __m256d past_x = _mm256_loadu_pd(&output_pin_x[i]);
+        __m256d past_y = _mm256_loadu_pd(&output_pin_y[i]);
+        __m256d dx1 = _mm256_sub_pd(_mm256_add_pd(fx, gx), past_x);
+        __m256d dy1 = _mm256_sub_pd(_mm256_add_pd(fy, gy), past_y);
+        __m256d dx2 = _mm256_sub_pd(_mm256_sub_pd(fx, gx), past_x);
+        __m256d dy2 = _mm256_sub_pd(_mm256_sub_pd(fy, gy), past_y);
+        __m256d first = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(dx1, dx1), _mm256_mul_pd(dy1, dy1)),
+                                      _mm256_add_pd(_mm256_mul_pd(dx2, dx2), _mm256_mul_pd(dy2, dy2)), _CMP_LT_OQ);
+        __m256d xo = _mm256_blendv_pd(_mm256_sub_pd(fx, gx), _mm256_add_pd(fx, gx), first);
+        __m256d yo = _mm256_blendv_pd(_mm256_sub_pd(fy, gy), _mm256_add_pd(fy, gy), first);
+
+        __m256d dxo = _mm256_sub_pd(xo, x1);
+        __m256d dyo = _mm256_sub_pd(yo, y1);
+        __m256d coupler = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dxo, dxo), _mm256_mul_pd(dyo, dyo)));
+        __m256d ux = _mm256_div_pd(dxo, coupler);
+        __m256d uy = _mm256_div_pd(dyo, coupler);
+
+        __m256d ct_along = _mm256_loadu_pd(&crank_top_along[i]);
+        __m256d ct_across = _mm256_loadu_pd(&crank_top_across[i]);
+        __m256d ot_along = _mm256_loadu_pd(&output_top_along[i]);
+        __m256d ot_across = _mm256_loadu_pd(&output_top_across[i]);
+        __m256d xct = _mm256_sub_pd(_mm256_add_pd(x1, _mm256_mul_pd(ct_along, ux)), _mm256_mul_pd(ct_across, uy));
+        __m256d yct = _mm256_add_pd(_mm256_add_pd(y1, _mm256_mul_pd(ct_along, uy)), _mm256_mul_pd(ct_across, ux));
+        __m256d xot = _mm256_sub_pd(_mm256_add_pd(x1, _mm256_mul_pd(ot_along, ux)), _mm256_mul_pd(ot_across, uy));
+        __m256d yot = _mm256_add_pd(_mm256_add_pd(y1, _mm256_mul_pd(ot_along, uy)), _mm256_mul_pd(ot_across, ux));
+
+        // Infeasible lanes keep their previous pose
+        _mm256_storeu_pd(&crank_pin_x[i], _mm256_blendv_pd(_mm256_loadu_pd(&crank_pin_x[i]), x1, ok));
+        _mm256_storeu_pd(&crank_pin_y[i], _mm256_blendv_pd(_mm256_loadu_pd(&crank_pin_y[i]), y1, ok));
+        _mm256_storeu_pd(&output_pin_x[i], _mm256_blendv_pd(past_x, xo, ok));
+        _mm256_storeu_pd(&output_pin_y[i], _mm256_blendv_pd(past_y, yo, ok));
+        _mm256_storeu_pd(&crank_top_x[i], _mm256_blendv_pd(_mm256_loadu_pd(&crank_top_x[i]), xct, ok));
+        _mm256_storeu_pd(&crank_top_y[i], _mm256_blendv_pd(_mm256_loadu_pd(&crank_top_y[i]), yct, ok));
+        _mm256_storeu_pd(&output_top_x[i], _mm256_blendv_pd(_mm256_loadu_pd(&output_top_x[i]), xot, ok));
+        _mm256_storeu_pd(&output_top_y[i], _mm256_blendv_pd(_mm256_loadu_pd(&output_top_y[i]), yot, ok));
+        int mask = _mm256_movemask_pd(ok);
+        for (int lane = 0; lane < 4; lane++)
+        {
+            feasible[i + lane] = (mask >> lane) & 1;
+        }
+        feasible_count += __builtin_popcount(mask);
+    }
+    return feasible_count;
+}
+#endif
+
+bool MechanismBatch::isFeasible(int index) const
+{
+    return this->feasible[index] != 0;
+}
+
+const std::tuple<double, double> MechanismBatch::getCrankPinPosition(int index) const
+{
+    return std::make_tuple(this->crank_pin_x[index], this->crank_pin_y[index]);
+}
+
+const std::tuple<double, double> MechanismBatch::getOutputPinPosition(int index) const
+{
+    return std::make_tuple(this->output_pin_x[index], this->output_pin_y[index]);
+}
+
+const std::tuple<std::tuple<double, double>, std::tuple<double, double>> MechanismBatch::getCouplerHeadTopPositions(int index) const
+{
+    return std::make_tuple(std::make_tuple(this->crank_top_x[index], this->crank_top_y[index]),
+                           std::make_tuple(this->output_top_x[index], this->output_top_y[index]));
+}
@@ -0,0 +1,71 @@
+#ifndef MECHANISMBATCH_H
+#define MECHANISMBATCH_H
+
+#include <vector>
+#include <tuple>
+#include "FourBarMechanism.h"
+
+// Holds many four bar mechanisms as a structure of arrays so the whole population can be
+// moved to the same crank angle in one sweep. The kinematics match FourBarMechanism::rotate,
+// but the circle intersection and the branch selection are vectorized across mechanisms
+// (AVX-512 or AVX2 when the compiler targets them, scalar otherwise).
+// Energies are not tracked, only the positions.
+class MechanismBatch
+{
+public:
+    MechanismBatch();
+    MechanismBatch(const std::vector<FourBarMechanism> &mechanisms);
+
+    void reserve(int capacity);
+    void addMechanism(const FourBarMechanism &mechanism);
+    int size() const;
+
+    // Rotates the crank of every mechanism to the given angle
+    // Mechanisms that can not be assembled at this angle keep their previous pose and are flagged as infeasible
+    // Returns the number of mechanisms that could be assembled
+    int rotateAll(double angle);
+
+    // Whether the mechanism could be assembled at the last angle given to rotateAll
+    bool isFeasible(int index) const;
+    const std::tuple<double, double> getCrankPinPosition(int index) const;
+    const std::tuple<double, double> getOutputPinPosition(int index) const;
+    const std::tuple<std::tuple<double, double>, std::tuple<double, double>> getCouplerHeadTopPositions(int index) const;
+
+private:
+    int rotateRange(int begin, int end, double cos_angle, double sin_angle);
+#if defined(__AVX512F__)
+    int rotateRangeAvx512(int begin, int end, double cos_angle, double sin_angle);
+#elif defined(__AVX2__)
+    int rotateRangeAvx2(int begin, int end, double cos_angle, double sin_angle);
+#endif
+
+    // Ground points
+    std::vector<double> input_ground_x;
+    std::vector<double> input_ground_y;
+    std::vector<double> output_ground_x;
+    std::vector<double> output_ground_y;
+
+    // Link lengths
+    std::vector<double> input_length;
+    std::vector<double> coupler_length;
+    std::vector<double> output_length;
+
+    // Coupler head top points in the coupler frame, whose origin is the crank pin and whose x axis points to the output pin
+    std::vector<double> crank_top_along;
+    std::vector<double> crank_top_across;
+    std::vector<double> output_top_along;
+    std::vector<double> output_top_across;
+
+    // Current pin positions
+    std::vector<double> crank_pin_x;
+    std::vector<double> crank_pin_y;
+    std::vector<double> output_pin_x;
+    std::vector<double> output_pin_y;
+    std::vector<double> crank_top_x;
+    std::vector<double> crank_top_y;
+    std::vector<double> output_top_x;
+    std::vector<double> output_top_y;
+
+    std::vector<unsigned char> feasible;
+};
+#endif
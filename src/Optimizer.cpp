@@ -1,23 +1,55 @@
 #include "Optimizer.h"
 #include "Link.h"
 #include "CouplerHead.h"
+#include "RandomStream.h"
 #include <random>
 #include <tuple>
 #include <algorithm>
 #include <iostream>
+#include <chrono>
+#include <cmath>
 
-std::uniform_real_distribution<> dist(0, 1);
+// A fitness function without a cutoff evaluates every mechanism fully
+Optimizer::Optimizer(int generation_size, int chunk_size, int max_num_threads, std::function<double(const FourBarMechanism &)> fitness_function, GenerationLimits generation_limits)
+    : Optimizer(generation_size, chunk_size, max_num_threads, [fitness_function](const FourBarMechanism &mechanism, double cutoff)
+                { return fitness_function(mechanism); }, generation_limits)
+{
+    this->uses_cutoff = false;
+}
 
-Optimizer::Optimizer(int generation_size, int chunk_size, int max_num_threads, std::function<double(FourBarMechanism)> fitness_function, GenerationLimits generation_limits)
+// chunk_size is the chunk size of the first evaluations, before the pool has measured the cost of the fitness function
+Optimizer::Optimizer(int generation_size, int chunk_size, int max_num_threads, std::function<double(const FourBarMechanism &, double)> fitness_function, GenerationLimits generation_limits)
+    : thread_pool(max_num_threads, chunk_size)
 {
     this->generation_size = generation_size;
     this->chunk_size = chunk_size;
     this->num_threads = max_num_threads;
     this->fitness_function = fitness_function;
+    this->cutoff = std::numeric_limits<double>::infinity();
+    this->uses_cutoff = true;
     this->generation_limits = generation_limits;
-    this->thread_pool.resize(num_threads);
-    this->random_engine = std::mt19937(random_device());
-    std::uniform_real_distribution<> uniform_dist(0, 1);
+    // The limits of each coordinate, in the order of a genome
+    const std::tuple<double, double> *lower_points[] = {&generation_limits.input_ground_point_lower_limit, &generation_limits.input_coupler_point_lower_limit,
+                                                        &generation_limits.coupler_output_point_lower_limit, &generation_limits.output_ground_point_lower_limit,
+                                                        &generation_limits.couplertop_input_point_lower_limit, &generation_limits.couplertop_output_point_lower_limit};
+    const std::tuple<double, double> *upper_points[] = {&generation_limits.input_ground_point_upper_limit, &generation_limits.input_coupler_point_upper_limit,
+                                                        &generation_limits.coupler_output_point_upper_limit, &generation_limits.output_ground_point_upper_limit,
+                                                        &generation_limits.couplertop_input_point_upper_limit, &generation_limits.couplertop_output_point_upper_limit};
+    for (int point = 0; point < 6; point++)
+    {
+        this->lower_limits[2 * point] = std::get<0>(*lower_points[point]);
+        this->lower_limits[2 * point + 1] = std::get<1>(*lower_points[point]);
+        this->upper_limits[2 * point] = std::get<0>(*upper_points[point]);
+        this->upper_limits[2 * point + 1] = std::get<1>(*upper_points[point]);
+    }
+    // Every buffer of a generation is allocated here, optimize only writes to them
+    this->current_generation.reserve(generation_size);
+    this->next_generation.reserve(generation_size);
+    this->selected_genomes.reserve(generation_size);
+    this->hall_of_fame.reserve(hall_of_fame_size);
+    this->current_fitnesses.reserve(generation_size);
+    // Different runs unless setSeed is called
+    this->seed = std::random_device()();
 }
 
 void Optimizer::setLinearDensity(double linear_density)
@@ -25,86 +57,150 @@ void Optimizer::setLinearDensity(double linear_density)
     this->linear_density = linear_density;
 }
 
-std::vector<FourBarMechanism> Optimizer::generate_random_chunk(int chunk_size)
+void Optimizer::setMutationRate(double mutation_rate)
 {
-    std::vector<FourBarMechanism> mechanisms;
-    for (int i = 0; i < chunk_size; i++)
+    this->mutation_rate = mutation_rate;
+}
+
+void Optimizer::setSurvivalRate(double survival_rate)
+{
+    this->survival_rate = survival_rate;
+}
+
+void Optimizer::setHallOfFameSize(int hall_of_fame_size)
+{
+    this->hall_of_fame_size = std::max(hall_of_fame_size, 1);
+    this->hall_of_fame.reserve(this->hall_of_fame_size);
+    if ((int)this->hall_of_fame.size() > this->hall_of_fame_size)
     {
-        mechanisms.push_back(generate_random_mechanism());
+        this->hall_of_fame.resize(this->hall_of_fame_size);
     }
-    return mechanisms;
 }
 
-FourBarMechanism Optimizer::generate_random_mechanism()
-{
-    std::tuple<double, double> input_ground_point = std::make_tuple(random_double(std::get<0>(generation_limits.input_ground_point_lower_limit), std::get<0>(generation_limits.input_ground_point_upper_limit)),
-                                                                    random_double(std::get<1>(generation_limits.input_ground_point_lower_limit), std::get<1>(generation_limits.input_ground_point_upper_limit)));
-    std::tuple<double, double> input_coupler_point = std::make_tuple(random_double(std::get<0>(generation_limits.input_coupler_point_lower_limit), std::get<0>(generation_limits.input_coupler_point_upper_limit)),
-                                                                     random_double(std::get<1>(generation_limits.input_coupler_point_lower_limit), std::get<1>(generation_limits.input_coupler_point_upper_limit)));
-    std::tuple<double, double> coupler_output_point = std::make_tuple(random_double(std::get<0>(generation_limits.coupler_output_point_lower_limit), std::get<0>(generation_limits.coupler_output_point_upper_limit)),
-                                                                      random_double(std::get<1>(generation_limits.coupler_output_point_lower_limit), std::get<1>(generation_limits.coupler_output_point_upper_limit)));
-    std::tuple<double, double> output_ground_point = std::make_tuple(random_double(std::get<0>(generation_limits.output_ground_point_lower_limit), std::get<0>(generation_limits.output_ground_point_upper_limit)),
-                                                                     random_double(std::get<1>(generation_limits.output_ground_point_lower_limit), std::get<1>(generation_limits.output_ground_point_upper_limit)));
-    std::tuple<double, double> couplertop_input_point = std::make_tuple(random_double(std::get<0>(generation_limits.couplertop_input_point_lower_limit), std::get<0>(generation_limits.couplertop_input_point_upper_limit)),
-                                                                        random_double(std::get<1>(generation_limits.couplertop_input_point_lower_limit), std::get<1>(generation_limits.couplertop_input_point_upper_limit)));
-    std::tuple<double, double> couplertop_output_point = std::make_tuple(random_double(std::get<0>(generation_limits.couplertop_output_point_lower_limit), std::get<0>(generation_limits.couplertop_output_point_upper_limit)),
-                                                                         random_double(std::get<1>(generation_limits.couplertop_output_point_lower_limit), std::get<1>(generation_limits.couplertop_output_point_upper_limit)));
-    Link input_link = Link(input_ground_point, input_coupler_point, linear_density);
-    Link coupler_link = Link(input_coupler_point, coupler_output_point, linear_density);
-    Link output_link = Link(coupler_output_point, output_ground_point, linear_density);
-    CouplerHead coupler_head = CouplerHead(input_link, output_link, couplertop_input_point, couplertop_output_point, linear_density);
-    FourBarMechanism mechanism = FourBarMechanism(input_link, coupler_link, output_link, coupler_head);
-    // Setting for default, pi/2 angle
-    // mechanism.rotate(1.57079632679, 1);
-    return mechanism;
+void Optimizer::setElitism(bool elitism)
+{
+    this->elitism = elitism;
+}
+
+void Optimizer::setFitnessCache(int capacity)
+{
+    if (capacity > 0)
+    {
+        this->fitness_cache = std::make_unique<FitnessCache>(capacity);
+    }
+    else
+    {
+        this->fitness_cache = nullptr;
+    }
+}
+
+long Optimizer::getCacheHitCount() const
+{
+    return fitness_cache ? fitness_cache->getHitCount() : 0;
+}
+
+long Optimizer::getCacheMissCount() const
+{
+    return fitness_cache ? fitness_cache->getMissCount() : 0;
+}
+
+long Optimizer::getRejectedCount() const
+{
+    return rejected_count;
+}
+
+void Optimizer::setSeed(std::uint64_t seed)
+{
+    this->seed = seed;
+    this->generation_index = 0;
+}
+
+void Optimizer::setVerbose(bool verbose)
+{
+    this->verbose = verbose;
+}
+
+void Optimizer::generate_random_chunk(std::vector<Genome> &genomes, int chunk_size)
+{
+    auto start = std::chrono::steady_clock::now();
+    genomes.resize(chunk_size);
+    thread_pool.parallelFor(chunk_size, [&](int begin, int end)
+                            {
+        for (int i = begin; i < end; i++)
+        {
+            RandomStream random(seed, generation_index, i);
+            generate_random_genome(random, genomes[i]);
+        } });
+    generation_index++;
+    generation_seconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / 1e9;
+    generated_count += chunk_size;
+}
+
+void Optimizer::generate_random_genome(RandomStream &random, Genome &genome) const
+{
+    for (int i = 0; i < (int)genome.size(); i++)
+    {
+        genome[i] = random_double(random, lower_limits[i], upper_limits[i]);
+    }
 }
 
-FourBarMechanism Optimizer::generate_children(const FourBarMechanism &parent1, const FourBarMechanism &parent2)
-{
-    auto [parent1_input_ground_point, parent1_input_coupler_point] = parent1.getInputLinkPositions();
-    auto [parent1_coupler_output_point, parent1_output_ground_point] = parent1.getOutputLinkPositions();
-    auto [parent1_couplertop_input_point, parent1_couplertop_output_point] = parent1.getCouplerHeadTopPositions();
-
-    auto [parent2_input_ground_point, parent2_input_coupler_point] = parent2.getInputLinkPositions();
-    auto [parent2_coupler_output_point, parent2_output_ground_point] = parent2.getOutputLinkPositions();
-    auto [parent2_couplertop_input_point, parent2_couplertop_output_point] = parent2.getCouplerHeadTopPositions();
-
-    std::tuple<double, double> input_ground_point = std::make_tuple(random_double(std::get<0>(parent1_input_ground_point), std::get<0>(parent2_input_ground_point)) * (1 + random_double(-1, 1) * mutation_rate),
-                                                                    random_double(std::get<1>(parent1_input_ground_point), std::get<1>(parent2_input_ground_point)) * (1 + random_double(-1, 1) * mutation_rate));
-    std::tuple<double, double> input_coupler_point = std::make_tuple(random_double(std::get<0>(parent1_input_coupler_point), std::get<0>(parent2_input_coupler_point)) * (1 + random_double(-1, 1) * mutation_rate),
-                                                                     random_double(std::get<1>(parent1_input_coupler_point), std::get<1>(parent2_input_coupler_point)) * (1 + random_double(-1, 1) * mutation_rate));
-    std::tuple<double, double> coupler_output_point = std::make_tuple(random_double(std::get<0>(parent1_coupler_output_point), std::get<0>(parent2_coupler_output_point)) * (1 + random_double(-1, 1) * mutation_rate),
-                                                                      random_double(std::get<1>(parent1_coupler_output_point), std::get<1>(parent2_coupler_output_point)) * (1 + random_double(-1, 1) * mutation_rate));
-    std::tuple<double, double> output_ground_point = std::make_tuple(random_double(std::get<0>(parent1_output_ground_point), std::get<0>(parent2_output_ground_point)) * (1 + random_double(-1, 1) * mutation_rate),
-                                                                     random_double(std::get<1>(parent1_output_ground_point), std::get<1>(parent2_output_ground_point)) * (1 + random_double(-1, 1) * mutation_rate));
-    std::tuple<double, double> couplertop_input_point = std::make_tuple(random_double(std::get<0>(parent1_couplertop_input_point), std::get<0>(parent2_couplertop_input_point)) * (1 + random_double(-1, 1) * mutation_rate),
-                                                                        random_double(std::get<1>(parent1_couplertop_input_point), std::get<1>(parent2_couplertop_input_point)) * (1 + random_double(-1, 1) * mutation_rate));
-    std::tuple<double, double> couplertop_output_point = std::make_tuple(random_double(std::get<0>(parent1_couplertop_output_point), std::get<0>(parent2_couplertop_output_point)) * (1 + random_double(-1, 1) * mutation_rate),
-                                                                         random_double(std::get<1>(parent1_couplertop_output_point), std::get<1>(parent2_couplertop_output_point)) * (1 + random_double(-1, 1) * mutation_rate));
+FourBarMechanism Optimizer::build_mechanism(const Genome &genome) const
+{
+    std::tuple<double, double> input_ground_point = std::make_tuple(genome[0], genome[1]);
+    std::tuple<double, double> input_coupler_point = std::make_tuple(genome[2], genome[3]);
+    std::tuple<double, double> coupler_output_point = std::make_tuple(genome[4], genome[5]);
+    std::tuple<double, double> output_ground_point = std::make_tuple(genome[6], genome[7]);
+    std::tuple<double, double> couplertop_input_point = std::make_tuple(genome[8], genome[9]);
+    std::tuple<double, double> couplertop_output_point = std::make_tuple(genome[10], genome[11]);
     Link input_link = Link(input_ground_point, input_coupler_point, linear_density);
     Link coupler_link = Link(input_coupler_point, coupler_output_point, linear_density);
     Link output_link = Link(coupler_output_point, output_ground_point, linear_density);
     CouplerHead coupler_head = CouplerHead(input_link, output_link, couplertop_input_point, couplertop_output_point, linear_density);
     FourBarMechanism mechanism = FourBarMechanism(input_link, coupler_link, output_link, coupler_head);
+    // Setting for default, pi/2 angle
     // mechanism.rotate(1.57079632679, 1);
     return mechanism;
 }
 
-std::vector<FourBarMechanism> Optimizer::generate_children_chunk(const std::vector<FourBarMechanism> &parents, int chunk_size)
+void Optimizer::generate_children(const Genome &parent1, const Genome &parent2, RandomStream &random, Genome &child) const
 {
-    std::vector<FourBarMechanism> children;
-    for (int i = 0; i < chunk_size; i++)
+    // Every coordinate is crossed over between the parents, then mutated
+    for (int i = 0; i < (int)child.size(); i++)
     {
-        int parent1_index = random_int(0, parents.size() - 1);
-        int parent2_index = random_int(0, parents.size() - 1);
-        children.push_back(generate_children(parents[parent1_index], parents[parent2_index]));
+        double crossed = random_double(random, parent1[i], parent2[i]);
+        child[i] = crossed * (1 + random_double(random, -1, 1) * mutation_rate);
     }
-    return children;
 }
 
-int Optimizer::random_int(int lower_limit, int upper_limit)
+void Optimizer::generate_children_chunk(const std::vector<Genome> &parents, const std::vector<int> &selected, std::vector<Genome> &children, int chunk_size)
 {
-    return keep_in_bounds(lower_limit + uniform_dist(random_engine) * (upper_limit - lower_limit), lower_limit, upper_limit);
+    auto start = std::chrono::steady_clock::now();
+    children.resize(chunk_size);
+    int elite_count = elitism ? std::min((int)selected.size(), chunk_size) : 0;
+    // Each worker writes its range of children in place, the parents are only read
+    thread_pool.parallelFor(chunk_size, [&](int begin, int end)
+                            {
+        for (int i = begin; i < end; i++)
+        {
+            if (i < elite_count)
+            {
+                children[i] = parents[selected[i]];
+                continue;
+            }
+            // The numbers of a child only depend on the seed, the generation and the child
+            RandomStream random(seed, generation_index, i);
+            int parent1_index = random_int(random, 0, selected.size() - 1);
+            int parent2_index = random_int(random, 0, selected.size() - 1);
+            generate_children(parents[selected[parent1_index]], parents[selected[parent2_index]], random, children[i]);
+        } });
+    generation_index++;
+    generation_seconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / 1e9;
+    generated_count += chunk_size;
+}
+
+int Optimizer::random_int(RandomStream &random, int lower_limit, int upper_limit)
+{
+    return keep_in_bounds(lower_limit + random.uniform() * (upper_limit - lower_limit), lower_limit, upper_limit);
 }
 
 int Optimizer::keep_in_bounds(int value, int lower_limit, int upper_limit)
@@ -122,98 +218,189 @@ int Optimizer::keep_in_bounds(int value, int lower_limit, int upper_limit)
         return value;
     }
 }
-double Optimizer::random_double(double lower_limit, double upper_limit)
+double Optimizer::random_double(RandomStream &random, double lower_limit, double upper_limit)
 {
-    return lower_limit + (upper_limit - lower_limit) * uniform_dist(random_engine);
+    return random.uniform(lower_limit, upper_limit);
 }
 
-static std::vector<std::tuple<FourBarMechanism, double>> evaluate_chunk(int id, const std::vector<FourBarMechanism> &mechanisms, std::function<double(FourBarMechanism)> fitness_function)
+void Optimizer::evaluate_genomes(const std::vector<Genome> &genomes, std::vector<double> &fitnesses)
 {
-    std::vector<std::tuple<FourBarMechanism, double>> evaluated_mechanisms;
-    int chunk_size = mechanisms.size();
-    for (int i = 0; i < chunk_size; i++)
+    auto start = std::chrono::steady_clock::now();
+    int size = genomes.size();
+    fitnesses.resize(size);
+    // Each range writes to its own fitnesses, the genomes are only read
+    thread_pool.parallelFor(size, [&](int begin, int end)
+                            {
+        for (int i = begin; i < end; i++)
+        {
+            if (fitness_cache && fitness_cache->find(genomes[i], fitnesses[i]))
+            {
+                continue;
+            }
+            fitnesses[i] = this->fitness_function(build_mechanism(genomes[i]), cutoff);
+            // A rejection only holds for this cutoff
+            if (fitness_cache && std::isfinite(fitnesses[i]))
+            {
+                fitness_cache->insert(genomes[i], fitnesses[i]);
+            }
+        } });
+    evaluation_seconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / 1e9;
+    evaluated_count += size;
+    int rejected = 0;
+    for (int i = 0; i < size; i++)
+    {
+        rejected += std::isinf(fitnesses[i]);
+    }
+    rejected_count += rejected;
+    if (verbose)
     {
-        evaluated_mechanisms.push_back(std::make_tuple(mechanisms[i], fitness_function(mechanisms[i])));
+        std::cout << "All chunks evaluated, " << thread_pool.getStolenCount() << " mechanisms stolen, " << rejected << " rejected by the cutoff";
+        if (fitness_cache)
+        {
+            std::cout << ", " << fitness_cache->getHitCount() << " cache hits and " << fitness_cache->getMissCount() << " misses so far";
+        }
+        std::cout << std::endl;
     }
-    return evaluated_mechanisms;
 }
 
-std::vector<std::tuple<FourBarMechanism, double>> Optimizer::evaluate_mechanisms(const std::vector<FourBarMechanism> &mechanisms)
+void Optimizer::select_genomes(const std::vector<double> &fitnesses, std::vector<int> &selected)
 {
-    std::vector<std::tuple<FourBarMechanism, double>> evaluated_mechanisms;
-    std::vector<std::future<std::vector<std::tuple<FourBarMechanism, double>>>> futures;
-    for (int i = 0; i < mechanisms.size(); i += chunk_size)
+    int size = fitnesses.size();
+    int population_size = std::min(std::max(1, (int)(size * survival_rate)), size);
+    selected.resize(size);
+    for (int i = 0; i < size; i++)
     {
-        // Standard library version
-        // futures.push_back(std::async(std::launch::async, evaluate_chunk, std::vector<FourBarMechanism>(mechanisms.begin() + i, mechanisms.begin() + i + chunk_size), chunk_size, this->fitness_function));
-        // Thread pool version
-        futures.push_back(thread_pool.push(evaluate_chunk, std::vector<FourBarMechanism>(mechanisms.begin() + i, mechanisms.begin() + i + chunk_size), this->fitness_function));
-        std::cout << "Submitted chunk " << i / chunk_size << " of " << mechanisms.size() / chunk_size << std::endl;
+        selected[i] = i;
     }
-    // Waits for all threads to finish, including non-executed functions.
-    thread_pool.stop(true);
-    std::cout << "All chunks evaluated" << std::endl;
-    for (int i = 0; i < futures.size(); i++)
-    {
-        std::vector<std::tuple<FourBarMechanism, double>> evaluated_mechanisms_chunk = futures[i].get();
-        evaluated_mechanisms.insert(evaluated_mechanisms.end(), evaluated_mechanisms_chunk.begin(), evaluated_mechanisms_chunk.end());
-    }
-    return evaluated_mechanisms;
+    // Only the first population_size indices need to be the best ones, not sorted
+    std::nth_element(selected.begin(), selected.begin() + population_size - 1, selected.end(), [&](int a, int b)
+                     { return ranksBefore(fitnesses, a, b); });
+    selected.resize(population_size);
 }
 
-std::vector<FourBarMechanism> Optimizer::select_mechanisms(const std::vector<std::tuple<FourBarMechanism, double>> &evaluated_mechanisms)
+bool Optimizer::ranksBefore(const std::vector<double> &fitnesses, int a, int b)
 {
-    std::vector<FourBarMechanism> selected_mechanisms;
-    std::vector<double> fitnesses;
-    int population_size = std::max(1, (int)(evaluated_mechanisms.size() * survival_rate));
-    for (int i = 0; i < evaluated_mechanisms.size(); i++)
-    {
-        fitnesses.push_back(std::get<1>(evaluated_mechanisms[i]));
-    }
-    std::sort(fitnesses.begin(), fitnesses.end());
-    double fitness_threshold = fitnesses[population_size];
-    for (int i = 0; i < evaluated_mechanisms.size(); i++)
+    // NaN compares false with everything, nth_element could then leave it anywhere and keep it over better genomes
+    double fitness_a = std::isnan(fitnesses[a]) ? std::numeric_limits<double>::infinity() : fitnesses[a];
+    double fitness_b = std::isnan(fitnesses[b]) ? std::numeric_limits<double>::infinity() : fitnesses[b];
+    return fitness_a < fitness_b || (fitness_a == fitness_b && a < b);
+}
+
+void Optimizer::update_hall_of_fame(const std::vector<Genome> &genomes, const std::vector<double> &fitnesses, const std::vector<int> &selected)
+{
+    for (int index : selected)
     {
-        if (std::get<1>(evaluated_mechanisms[i]) <= fitness_threshold)
+        double fitness = fitnesses[index];
+        // Rejected genomes were not evaluated fully
+        if (!std::isfinite(fitness))
+        {
+            continue;
+        }
+        bool full = (int)hall_of_fame.size() == hall_of_fame_size;
+        if (full && !(fitness < hall_of_fame.back().fitness))
+        {
+            continue;
+        }
+        // Survivors are often evaluated again unchanged, they are only kept once
+        bool known = false;
+        for (const HallOfFameEntry &entry : hall_of_fame)
+        {
+            known = known || entry.genome == genomes[index];
+        }
+        if (known)
         {
-            selected_mechanisms.push_back(std::get<0>(evaluated_mechanisms[i]));
+            continue;
         }
+        if (full)
+        {
+            hall_of_fame.pop_back();
+        }
+        // Sorted insertion, after the entries of equal fitness that were found first
+        auto position = std::upper_bound(hall_of_fame.begin(), hall_of_fame.end(), fitness, [](double value, const HallOfFameEntry &entry)
+                                         { return value < entry.fitness; });
+        hall_of_fame.insert(position, HallOfFameEntry{genomes[index], fitness});
     }
-    return selected_mechanisms;
 }
 
 void Optimizer::optimize(int iterations)
 {
-    std::vector<FourBarMechanism> current_gen = generate_random_chunk(generation_size);
+    // The random generation is ranked fully
+    cutoff = std::numeric_limits<double>::infinity();
+    generate_random_chunk(current_generation, generation_size);
     for (int i = 0; i < iterations; i++)
     {
-        std::cout << "Generation " << i << " of " << iterations << " completed."
-                  << "\n";
+        if (verbose)
+        {
+            std::cout << "Generation " << i << " of " << iterations << " completed."
+                      << "\n";
+        }
         // Evaluates the current generation
-        std::vector<FourBarMechanism> selected_mechanisms = select_mechanisms(evaluate_mechanisms(current_gen));
-        std::cout << "Selected " << selected_mechanisms.size() << " mechanisms."
-                  << "\n";
-        // Replaces it with the next generation
-        current_gen = generate_children_chunk(selected_mechanisms, generation_size);
-        std::cout << "Generated " << current_gen.size() << " children."
-                  << "\n";
+        evaluate_genomes(current_generation, current_fitnesses);
+        select_genomes(current_fitnesses, selected_genomes);
+        update_hall_of_fame(current_generation, current_fitnesses, selected_genomes);
+        // The worst survivor, nth_element leaves it last. Children that do not beat it only survive if too few of them do
+        // It is infinite if rejected or NaN genomes survived, then the next generation is evaluated fully
+        if (uses_cutoff)
+        {
+            cutoff = current_fitnesses[selected_genomes.back()];
+            if (std::isnan(cutoff))
+            {
+                cutoff = std::numeric_limits<double>::infinity();
+            }
+        }
+        if (verbose)
+        {
+            std::cout << "Selected " << selected_genomes.size() << " mechanisms."
+                      << "\n";
+        }
+        // Replaces it with the next generation, the two arenas are swapped so neither is reallocated
+        generate_children_chunk(current_generation, selected_genomes, next_generation, generation_size);
+        std::swap(current_generation, next_generation);
+        if (verbose)
+        {
+            std::cout << "Generated " << current_generation.size() << " children."
+                      << "\n";
+        }
     }
-    this->current_best_generation = select_mechanisms(evaluate_mechanisms(current_gen));
+    evaluate_genomes(current_generation, current_fitnesses);
+    select_genomes(current_fitnesses, selected_genomes);
+    update_hall_of_fame(current_generation, current_fitnesses, selected_genomes);
+}
+
+double Optimizer::getEvaluationThroughput() const
+{
+    return evaluated_count / evaluation_seconds;
+}
+
+double Optimizer::getGenerationThroughput() const
+{
+    return generated_count / generation_seconds;
 }
 
 std::vector<FourBarMechanism> Optimizer::getBestMechanisms(int num_mechanisms)
 {
-    return current_best_generation;
+    std::vector<FourBarMechanism> mechanisms;
+    for (int i = 0; i < std::min(num_mechanisms, (int)hall_of_fame.size()); i++)
+    {
+        mechanisms.push_back(build_mechanism(hall_of_fame[i].genome));
+    }
+    return mechanisms;
 }
 
 FourBarMechanism Optimizer::getBestMechanism()
 {
-    std::vector<std::tuple<FourBarMechanism, double>> evaluations = evaluate_mechanisms(current_best_generation);
-    std::vector<double> fitnesses;
-    for (int i = 0; i < evaluations.size(); i++)
+    if (hall_of_fame.empty())
+    {
+        throw HallOfFameIsEmpty("No mechanism has a finite fitness yet, hence there is no best mechanism");
+    }
+    return build_mechanism(hall_of_fame.front().genome);
+}
+
+double Optimizer::getBestFitness() const
+{
+    if (hall_of_fame.empty())
     {
-        fitnesses.push_back(std::get<1>(evaluations[i]));
+        throw HallOfFameIsEmpty("No mechanism has a finite fitness yet, hence there is no best fitness");
     }
-    int best_index = std::distance(fitnesses.begin(), std::max_element(fitnesses.begin(), fitnesses.end()));
-    return std::get<0>(evaluations[best_index]);
+    return hall_of_fame.front().fitness;
 }
\ No newline at end of file
@@ -4,8 +4,16 @@
 #include <vector>
 #include <tuple>
 #include <random>
+#include <functional>
+#include <memory>
+#include <limits>
+#include <cstdint>
+#include <stdexcept>
 #include "FourBarMechanism.h"
-#include "ctpl_stl.h"
+#include "WorkStealingPool.h"
+#include "RandomStream.h"
+#include "Genome.h"
+#include "FitnessCache.h"
 
 // Defines the geometric limits for generating any mechanism
 struct GenerationLimits
@@ -24,60 +32,132 @@ struct GenerationLimits
     std::tuple<double, double> couplertop_output_point_upper_limit;
 };
 
+// A genome of the hall of fame, with the fitness it was evaluated to
+struct HallOfFameEntry
+{
+    Genome genome;
+    double fitness;
+};
+
+// Thrown when the best mechanism is asked for before any mechanism with a finite fitness entered the hall of fame
+class HallOfFameIsEmpty : public std::logic_error
+{
+public:
+    using std::logic_error::logic_error;
+};
+
 // This class handles the optimization of a generation of mechanisms using a genetic algorithm
 class Optimizer
 {
 public:
-    Optimizer(int generation_size, int chunk_size, int max_num_threads, std::function<double(FourBarMechanism)> fitness_function, GenerationLimits generation_limits);
+    Optimizer(int generation_size, int chunk_size, int max_num_threads, std::function<double(const FourBarMechanism &)> fitness_function, GenerationLimits generation_limits);
+    // With a fitness function that is also given a cutoff, the fitness of the worst survivor of the previous generation
+    // It may stop evaluating a mechanism once it can prove that its fitness is above the cutoff, and then has to return
+    // infinity, so the rejected mechanism ranks after every mechanism that was evaluated fully. A lower bound could tie with
+    // or beat the exact fitness of a worse mechanism. A mechanism that can only tie the cutoff is evaluated fully, so a
+    // generation that can not improve still ranks its mechanisms. The cutoff is infinite for the first generation
+    Optimizer(int generation_size, int chunk_size, int max_num_threads, std::function<double(const FourBarMechanism &, double)> fitness_function, GenerationLimits generation_limits);
     // Will optimize the generation for the given number of iterations
     void optimize(int iterations);
 
-    // Will return the best mechanisms from the current generation
+    // Will return the best mechanisms found so far, best first, from the hall of fame
+    // At most the size of the hall of fame, nothing is evaluated again
     std::vector<FourBarMechanism> getBestMechanisms(int num_mechanisms);
+    // Throw HallOfFameIsEmpty before optimize, or when every fitness so far was infinite or NaN
     FourBarMechanism getBestMechanism();
+    double getBestFitness() const;
     // Simple setting functions
     void setLinearDensity(double linear_density);
     void setMutationRate(double mutation_rate);
     void setSurvivalRate(double survival_rate);
+    // Number of best genomes kept across generations, 10 by default
+    void setHallOfFameSize(int hall_of_fame_size);
+    // Caches the fitnesses of up to capacity genomes, so the survivors kept by elitism are not evaluated again
+    // Off by default, a capacity of 0 turns it off. The cache only skips work, the results are the same without it
+    // It only helps with setElitism(true): otherwise a child is almost never a copy of a genome evaluated before
+    void setFitnessCache(int capacity);
+    // Whether the survivors of a generation are copied unchanged into the next one, ahead of their children. Off by default
+    void setElitism(bool elitism);
+    // Genomes found in and missing from the cache since it was set
+    long getCacheHitCount() const;
+    long getCacheMissCount() const;
+    // Evaluated genomes with an infinite fitness, the ones the fitness function rejected at the cutoff
+    // They do not enter the hall of fame or the cache
+    long getRejectedCount() const;
+    // Runs with the same seed and settings give the same mechanisms, whatever the number of threads
+    void setSeed(std::uint64_t seed);
+    // Progress messages for every generation, on by default
+    void setVerbose(bool verbose);
+    // Genomes per second of wall time in each phase, over every generation optimized so far
+    double getEvaluationThroughput() const;
+    double getGenerationThroughput() const;
+    // Whether genome a ranks before genome b in the selection: the smaller fitness first, ties broken by index
+    // NaN ranks as infinity, after every number, so that the order stays a strict weak ordering
+    static bool ranksBefore(const std::vector<double> &fitnesses, int a, int b);
 
 private:
-    // Will split the generation into chunks and evaluate them in parallel
-    // Returns a vector of tuples containing the mechanism and its fitness
-    std::vector<std::tuple<FourBarMechanism, double>> evaluate_mechanisms(const std::vector<FourBarMechanism> &mechanisms);
-
-    // Will select the best mechanisms from the evaluated mechanisms
-    // The number of mechanisms returned will be defined by the survival rate
-    // The best mechanisms will be copied to the next generation
-    // The smaller the fitness, the better the mechanism
-    std::vector<FourBarMechanism> select_mechanisms(const std::vector<std::tuple<FourBarMechanism, double>> &evaluated_mechanisms);
-
-    // Will generate children from the best mechanisms by crossing over the parents with added mutations
-    FourBarMechanism generate_children(const FourBarMechanism &parent1, const FourBarMechanism &parent2);
-
-    // Will generate a random mechanism within the generation limits
-    FourBarMechanism generate_random_mechanism();
-
-    // Will generate a random mechanism within the generation limits
-    std::vector<FourBarMechanism> generate_random_chunk(int chunk_size);
-
-    // Random helping functions with speed optimization
-    double random_double(double lower_limit, double upper_limit);
-    int random_int(int lower_limit, int upper_limit);
-
-    int keep_in_bounds(int value, int lower_limit, int upper_limit);
-
-    // Will generate children from parent mechanisms
-    std::vector<FourBarMechanism> generate_children_chunk(const std::vector<FourBarMechanism> &parents, int chunk_size);
-
-    // At any moment will contain the current generation of selected mechanisms
-    std::vector<FourBarMechanism> current_best_generation;
-
-    // The geometric limits for generating any mechanism
+    // Will evaluate the genomes in parallel on the work stealing pool, in chunks that follow the cost of the fitness function
+    // Returns once every genome is evaluated, the pool keeps its workers for the next call
+    // fitnesses[i] is set to the fitness of genomes[i]. Each worker builds the mechanism of a genome on its own stack and
+    // writes the fitness in place, so nothing is copied, and nothing is allocated once fitnesses has held a generation
+    void evaluate_genomes(const std::vector<Genome> &genomes, std::vector<double> &fitnesses);
+
+    // Will select the best genomes from the evaluated genomes, writing their indices to selected
+    // Exactly the survival rate of the genomes are selected, at least one, in the order of ranksBefore
+    // The smaller the fitness, the better the genome. Partitions the indices in linear time instead of sorting them
+    void select_genomes(const std::vector<double> &fitnesses, std::vector<int> &selected);
+
+    // Will add the selected genomes that beat the worst genome of the hall of fame to it, if their fitness is finite
+    // Only the selected genomes are candidates, a hall of fame larger than the selection gets the best of them
+    void update_hall_of_fame(const std::vector<Genome> &genomes, const std::vector<double> &fitnesses, const std::vector<int> &selected);
+
+    // Will generate a child from two parents by crossing over their points with added mutations
+    void generate_children(const Genome &parent1, const Genome &parent2, RandomStream &random, Genome &child) const;
+
+    // Will generate a random genome within the generation limits
+    void generate_random_genome(RandomStream &random, Genome &genome) const;
+
+    // Will build the mechanism of a genome
+    FourBarMechanism build_mechanism(const Genome &genome) const;
+
+    // Will fill genomes with chunk_size random genomes within the generation limits, in parallel on the thread pool
+    void generate_random_chunk(std::vector<Genome> &genomes, int chunk_size);
+
+    // Random helping functions, drawing from the stream of the genome being generated
+    static double random_double(RandomStream &random, double lower_limit, double upper_limit);
+    static int random_int(RandomStream &random, int lower_limit, int upper_limit);
+
+    static int keep_in_bounds(int value, int lower_limit, int upper_limit);
+
+    // Will fill children with the selected parents when elitism is on, then with children of the selected parents up to
+    // chunk_size, in parallel on the thread pool
+    void generate_children_chunk(const std::vector<Genome> &parents, const std::vector<int> &selected, std::vector<Genome> &children, int chunk_size);
+
+    // The best distinct genomes evaluated so far and their fitnesses, sorted best first
+    // Kept across generations and calls to optimize, at most hall_of_fame_size of them
+    std::vector<HallOfFameEntry> hall_of_fame;
+    int hall_of_fame_size = 10;
+    // Two arenas of generation_size genomes: the generation being evaluated and the one its children are written to
+    // They are swapped every generation, and like every other buffer below they are allocated once by the constructor
+    std::vector<Genome> current_generation;
+    std::vector<Genome> next_generation;
+    // Indices of the selected genomes of the current generation
+    std::vector<int> selected_genomes;
+
+    // The geometric limits for generating any mechanism, and the same limits as genomes
     GenerationLimits generation_limits;
-
-    // The fitness function to be optimized
-    // The smaller the better
-    std::function<double(FourBarMechanism)> fitness_function;
+    Genome lower_limits;
+    Genome upper_limits;
+
+    // The fitness function to be optimized, given the cutoff
+    // The smaller the better. Called from the worker threads at the same time, with mechanisms it must not keep
+    std::function<double(const FourBarMechanism &, double)> fitness_function;
+    // Fitness of the worst survivor of the previous generation, infinite for the first generation of optimize
+    // Always infinite for a fitness function without a cutoff, so every fitness is exact
+    double cutoff;
+    bool uses_cutoff;
+    // Fitnesses of the generation being evaluated, kept between generations so they are not reallocated
+    std::vector<double> current_fitnesses;
 
     // Configs
     int generation_size;
@@ -86,13 +166,24 @@ private:
     double linear_density = 1;
     double mutation_rate = 1;
     double survival_rate = 0.1;
-
-    // Thread pool for parallel evaluation
-    ctpl::thread_pool thread_pool;
-
-    // Random engine for speed optimization
-    std::random_device random_device;
-    std::mt19937 random_engine;
-    std::uniform_real_distribution<> uniform_dist;
+    bool verbose = true;
+    bool elitism = false;
+
+    // Thread pool for parallel evaluation, alive from the constructor to the destructor
+    WorkStealingPool thread_pool;
+    // Fitnesses of evaluated genomes, nullptr when the cache is off
+    std::unique_ptr<FitnessCache> fitness_cache;
+
+    // Every generated genome draws from its own RandomStream, keyed by the seed, the generation and its index
+    std::uint64_t seed;
+    // Generations generated since the seed was set, the random one included
+    std::uint64_t generation_index = 0;
+
+    // Time spent and mechanisms handled in each phase
+    double evaluation_seconds = 0;
+    double generation_seconds = 0;
+    long evaluated_count = 0;
+    long generated_count = 0;
+    long rejected_count = 0;
 };
 #endif
\ No newline at end of file
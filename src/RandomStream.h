@@ -0,0 +1,44 @@
+#ifndef RANDOMSTREAM_H
+#define RANDOMSTREAM_H
+
+#include <cstdint>
+
+// Random numbers for one item of work, e.g. one child of one generation, derived from a seed and the item's keys
+// Each stream is a SplitMix64 sequence that starts at a hash of the seed and the keys, so streams can be created on any
+// thread in any order and still give the same numbers, and no state is shared between threads
+class RandomStream
+{
+public:
+    RandomStream(std::uint64_t seed, std::uint64_t key1, std::uint64_t key2 = 0)
+    {
+        this->state = mix(mix(mix(seed) + key1 * GOLDEN_GAMMA) + key2 * GOLDEN_GAMMA);
+    }
+
+    std::uint64_t next()
+    {
+        this->state += GOLDEN_GAMMA;
+        return mix(this->state);
+    }
+    // Uniform in [0, 1), from the upper 53 bits
+    double uniform()
+    {
+        return (next() >> 11) * 0x1.0p-53;
+    }
+    double uniform(double lower_limit, double upper_limit)
+    {
+        return lower_limit + (upper_limit - lower_limit) * uniform();
+    }
+
+private:
+    static constexpr std::uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15;
+    // The SplitMix64 finalizer
+    static std::uint64_t mix(std::uint64_t z)
+    {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    std::uint64_t state;
+};
+#endif
\ No newline at end of file
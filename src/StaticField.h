@@ -0,0 +1,220 @@
+#ifndef STATICFIELD_H
+#define STATICFIELD_H
+#include <array>
+#include <vector>
+#include <tuple>
+#include <limits>
+#include <cstdint>
+#include <utility>
+#include "Field.h"
+#include "CouplerCurve.h"
+
+// A field with a number of button pairs known at compile time, e.g. the three of optimize.cpp
+// Same queries as Field, but the pairs live in a std::array. getButtonPairPressedIndex and getClearance are folds with one
+// test per pair, the other queries are loops over the N pairs, which the compiler may unroll
+// The pose queries are about 3x faster than Field's (benchmarkStaticField), but that does not carry over to the sweep in
+// evaluateCycle, whose time goes into moving the mechanism: between runs it is 0.96x to 1.2x as fast as with a Field
+// Can be used wherever the field type is a template parameter (adaptiveSweep, evaluateCycle)
+template <std::size_t N>
+class StaticField
+{
+    static_assert(N > 0, "A StaticField needs at least one button pair");
+
+public:
+    constexpr StaticField(const std::array<ButtonPair, N> &button_pairs) : button_pairs(button_pairs) {}
+    // StaticField field(ButtonPair{...}, ButtonPair{...}, ButtonPair{...}) deduces N
+    template <typename... Pairs>
+    constexpr StaticField(const ButtonPair &first, const Pairs &...others) : button_pairs{first, others...} {}
+
+    constexpr const std::array<ButtonPair, N> &getButtonPairs() const
+    {
+        return this->button_pairs;
+    }
+    constexpr int getButtonPairCount() const
+    {
+        return N;
+    }
+    constexpr double getSmallestHitboxRadius() const
+    {
+        double smallest = std::numeric_limits<double>::infinity();
+        for (const ButtonPair &button_pair : this->button_pairs)
+        {
+            smallest = std::min(smallest, std::min(button_pair.r1, button_pair.r2));
+        }
+        return smallest;
+    }
+    constexpr double getClearance(const std::tuple<double, double> &mech_pos_1, const std::tuple<double, double> &mech_pos_2) const
+    {
+        return getClearance(std::get<0>(mech_pos_1), std::get<1>(mech_pos_1), std::get<0>(mech_pos_2), std::get<1>(mech_pos_2), std::make_index_sequence<N>());
+    }
+    // Returns the index of the first button pair that is being pressed, -1 if there is none
+    constexpr int getButtonPairPressedIndex(const std::tuple<double, double> &mech_pos_1, const std::tuple<double, double> &mech_pos_2) const
+    {
+        return getButtonPairPressedIndex(std::get<0>(mech_pos_1), std::get<1>(mech_pos_1), std::get<0>(mech_pos_2), std::get<1>(mech_pos_2), std::make_index_sequence<N>());
+    }
+    void getPressedMask(const std::tuple<double, double> &mech_pos_1, const std::tuple<double, double> &mech_pos_2, std::vector<std::uint64_t> &mask) const
+    {
+        mask.assign(getPressedMaskWords(), 0);
+        for (std::size_t i = 0; i < N; i++)
+        {
+            mask[i / 64] |= std::uint64_t(isButtonPairPressed(std::get<0>(mech_pos_1), std::get<1>(mech_pos_1), std::get<0>(mech_pos_2), std::get<1>(mech_pos_2), this->button_pairs[i])) << (i % 64);
+        }
+    }
+    constexpr int getPressedMaskWords() const
+    {
+        return (N + 63) / 64;
+    }
+    constexpr int getButtonPairSweptIndex(const std::tuple<double, double> &previous_pos_1, const std::tuple<double, double> &previous_pos_2,
+                                          const std::tuple<double, double> &mech_pos_1, const std::tuple<double, double> &mech_pos_2) const
+    {
+        double x1 = std::get<0>(previous_pos_1);
+        double y1 = std::get<1>(previous_pos_1);
+        double x2 = std::get<0>(previous_pos_2);
+        double y2 = std::get<1>(previous_pos_2);
+        double dx1 = std::get<0>(mech_pos_1) - x1;
+        double dy1 = std::get<1>(mech_pos_1) - y1;
+        double dx2 = std::get<0>(mech_pos_2) - x2;
+        double dy2 = std::get<1>(mech_pos_2) - y2;
+        for (std::size_t i = 0; i < N; i++)
+        {
+            const ButtonPair &button_pair = this->button_pairs[i];
+            double low = 0;
+            double high = 1;
+            clipToHitbox(x1, dx1, button_pair.x1, button_pair.r1, low, high);
+            clipToHitbox(y1, dy1, button_pair.y1, button_pair.r1, low, high);
+            clipToHitbox(x2, dx2, button_pair.x2, button_pair.r2, low, high);
+            clipToHitbox(y2, dy2, button_pair.y2, button_pair.r2, low, high);
+            if (low < high)
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+    void getSweptPressedMask(const std::tuple<double, double> &previous_pos_1, const std::tuple<double, double> &previous_pos_2,
+                             const std::tuple<double, double> &mech_pos_1, const std::tuple<double, double> &mech_pos_2, std::vector<std::uint64_t> &mask) const
+    {
+        double x1 = std::get<0>(previous_pos_1);
+        double y1 = std::get<1>(previous_pos_1);
+        double x2 = std::get<0>(previous_pos_2);
+        double y2 = std::get<1>(previous_pos_2);
+        double dx1 = std::get<0>(mech_pos_1) - x1;
+        double dy1 = std::get<1>(mech_pos_1) - y1;
+        double dx2 = std::get<0>(mech_pos_2) - x2;
+        double dy2 = std::get<1>(mech_pos_2) - y2;
+        mask.assign(getPressedMaskWords(), 0);
+        for (std::size_t i = 0; i < N; i++)
+        {
+            const ButtonPair &button_pair = this->button_pairs[i];
+            double low = 0;
+            double high = 1;
+            clipToHitbox(x1, dx1, button_pair.x1, button_pair.r1, low, high);
+            clipToHitbox(y1, dy1, button_pair.y1, button_pair.r1, low, high);
+            clipToHitbox(x2, dx2, button_pair.x2, button_pair.r2, low, high);
+            clipToHitbox(y2, dy2, button_pair.y2, button_pair.r2, low, high);
+            mask[i / 64] |= std::uint64_t(low < high) << (i % 64);
+        }
+    }
+    // Same as the curve queries of Field
+    void getCurvePressedMask(const CouplerCurve &curve, std::vector<std::uint64_t> &mask) const
+    {
+        mask.assign(getPressedMaskWords(), 0);
+        int size = curve.size();
+        for (int i = 0; i < size; i++)
+        {
+            auto [x1, y1] = curve.getCrankTopPosition(i);
+            auto [x2, y2] = curve.getOutputTopPosition(i);
+            for (std::size_t k = 0; k < N; k++)
+            {
+                mask[k / 64] |= std::uint64_t(isButtonPairPressed(x1, y1, x2, y2, this->button_pairs[k])) << (k % 64);
+            }
+        }
+    }
+    void getCurveSweptPressedMask(const CouplerCurve &curve, std::vector<std::uint64_t> &mask) const
+    {
+        mask.assign(getPressedMaskWords(), 0);
+        for (int segment = 0; segment < curve.getSegmentCount(); segment++)
+        {
+            int begin = curve.getSegmentBegin(segment);
+            auto [x1, y1] = curve.getCrankTopPosition(begin);
+            auto [x2, y2] = curve.getOutputTopPosition(begin);
+            for (std::size_t k = 0; k < N; k++)
+            {
+                mask[k / 64] |= std::uint64_t(isButtonPairPressed(x1, y1, x2, y2, this->button_pairs[k])) << (k % 64);
+            }
+            for (int i = begin + 1; i < curve.getSegmentEnd(segment); i++)
+            {
+                auto [next_x1, next_y1] = curve.getCrankTopPosition(i);
+                auto [next_x2, next_y2] = curve.getOutputTopPosition(i);
+                for (std::size_t k = 0; k < N; k++)
+                {
+                    const ButtonPair &button_pair = this->button_pairs[k];
+                    double low = 0;
+                    double high = 1;
+                    clipToHitbox(x1, next_x1 - x1, button_pair.x1, button_pair.r1, low, high);
+                    clipToHitbox(y1, next_y1 - y1, button_pair.y1, button_pair.r1, low, high);
+                    clipToHitbox(x2, next_x2 - x2, button_pair.x2, button_pair.r2, low, high);
+                    clipToHitbox(y2, next_y2 - y2, button_pair.y2, button_pair.r2, low, high);
+                    mask[k / 64] |= std::uint64_t(low < high) << (k % 64);
+                }
+                x1 = next_x1;
+                y1 = next_y1;
+                x2 = next_x2;
+                y2 = next_y2;
+            }
+        }
+    }
+    double getCurveClearance(const CouplerCurve &curve) const
+    {
+        double clearance = std::numeric_limits<double>::infinity();
+        int size = curve.size();
+        for (int i = 0; i < size; i++)
+        {
+            clearance = std::min(clearance, getClearance(curve.getCrankTopPosition(i), curve.getOutputTopPosition(i)));
+        }
+        return clearance;
+    }
+
+private:
+    std::array<ButtonPair, N> button_pairs;
+
+    // USES A SQUARE HIT BOX TO INCREASE PERFORMANCE, the same test as Field
+    static constexpr bool isButtonPairPressed(double x1, double y1, double x2, double y2, const ButtonPair &button_pair)
+    {
+        return x1 - button_pair.x1 < button_pair.r1 && button_pair.x1 - x1 < button_pair.r1 && y1 - button_pair.y1 < button_pair.r1 && button_pair.y1 - y1 < button_pair.r1 &&
+               x2 - button_pair.x2 < button_pair.r2 && button_pair.x2 - x2 < button_pair.r2 && y2 - button_pair.y2 < button_pair.r2 && button_pair.y2 - y2 < button_pair.r2;
+    }
+    // Same as Field::getButtonPairDistance
+    static constexpr double getButtonPairDistance(double x1, double y1, double x2, double y2, const ButtonPair &button_pair)
+    {
+        double distance_1 = std::max(std::max(x1 - button_pair.x1, button_pair.x1 - x1), std::max(y1 - button_pair.y1, button_pair.y1 - y1)) - button_pair.r1;
+        double distance_2 = std::max(std::max(x2 - button_pair.x2, button_pair.x2 - x2), std::max(y2 - button_pair.y2, button_pair.y2 - y2)) - button_pair.r2;
+        return std::max(distance_1, distance_2);
+    }
+    // The folds expand to one test per pair, the || stops at the first pressed one
+    template <std::size_t... I>
+    constexpr int getButtonPairPressedIndex(double x1, double y1, double x2, double y2, std::index_sequence<I...>) const
+    {
+        int index = -1;
+        (void)((isButtonPairPressed(x1, y1, x2, y2, this->button_pairs[I]) && (index = I, true)) || ...);
+        return index;
+    }
+    template <std::size_t... I>
+    constexpr double getClearance(double x1, double y1, double x2, double y2, std::index_sequence<I...>) const
+    {
+        double clearance = std::numeric_limits<double>::infinity();
+        double distances[] = {getButtonPairDistance(x1, y1, x2, y2, this->button_pairs[I])...};
+        for (double distance : distances)
+        {
+            if (distance >= 0)
+            {
+                clearance = std::min(clearance, distance);
+            }
+        }
+        return clearance;
+    }
+};
+
+template <typename... Pairs>
+StaticField(const ButtonPair &first, const Pairs &...others) -> StaticField<1 + sizeof...(Pairs)>;
+#endif
\ No newline at end of file
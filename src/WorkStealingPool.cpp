@@ -0,0 +1,193 @@
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <chrono>
+
+WorkStealingPool::WorkStealingPool(int num_threads, int initial_chunk_size)
+{
+    this->initial_chunk_size = std::max(initial_chunk_size, 1);
+    this->stolen_count = 0;
+    num_threads = std::max(num_threads, 1);
+    for (int i = 0; i < num_threads; i++)
+    {
+        this->workers.push_back(std::make_unique<Worker>());
+    }
+    // Started once every worker exists, since a thief looks at all of them
+    for (int i = 0; i < num_threads; i++)
+    {
+        this->workers[i]->thread = std::thread(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->start_work.notify_all();
+    for (std::unique_ptr<Worker> &worker : this->workers)
+    {
+        worker->thread.join();
+    }
+}
+
+int WorkStealingPool::size() const
+{
+    return this->workers.size();
+}
+
+long WorkStealingPool::getStolenCount() const
+{
+    return this->stolen_count;
+}
+
+void WorkStealingPool::run(int count, const void *body, Invoker invoker)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+    // Every worker starts with an equal contiguous part
+    int num_workers = this->workers.size();
+    for (int i = 0; i < num_workers; i++)
+    {
+        std::unique_lock<std::mutex> lock(this->workers[i]->mutex);
+        this->workers[i]->begin = (long)count * i / num_workers;
+        this->workers[i]->end = (long)count * (i + 1) / num_workers;
+    }
+    this->body = body;
+    this->invoker = invoker;
+    this->stolen_count = 0;
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->error = nullptr;
+        this->busy_workers = num_workers;
+        this->generation++;
+    }
+    this->start_work.notify_all();
+
+    // Waits for every worker, not only every item, so no worker is still looking at the parts when the next run fills them
+    std::exception_ptr run_error;
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->work_done.wait(lock, [this]
+                             { return this->busy_workers == 0; });
+        run_error = this->error;
+        this->error = nullptr;
+    }
+    if (run_error)
+    {
+        std::rethrow_exception(run_error);
+    }
+}
+
+void WorkStealingPool::workerLoop(int id)
+{
+    long seen_generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->start_work.wait(lock, [&]
+                                  { return this->stopping || this->generation != seen_generation; });
+            if (this->stopping)
+            {
+                return;
+            }
+            seen_generation = this->generation;
+        }
+        work(id);
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->busy_workers--;
+        if (this->busy_workers == 0)
+        {
+            this->work_done.notify_all();
+        }
+    }
+}
+
+void WorkStealingPool::work(int id)
+{
+    Worker &worker = *this->workers[id];
+    int begin;
+    int end;
+    while (true)
+    {
+        if (!takeChunk(id, begin, end))
+        {
+            if (!steal(id))
+            {
+                return;
+            }
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        try
+        {
+            this->invoker(this->body, begin, end);
+        }
+        catch (...)
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if (!this->error)
+            {
+                this->error = std::current_exception();
+            }
+        }
+        auto finish = std::chrono::steady_clock::now();
+        double item_nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start).count() / double(end - begin);
+        worker.nanoseconds_per_item = worker.nanoseconds_per_item == 0 ? item_nanoseconds : 0.75 * worker.nanoseconds_per_item + 0.25 * item_nanoseconds;
+    }
+}
+
+bool WorkStealingPool::takeChunk(int id, int &begin, int &end)
+{
+    Worker &worker = *this->workers[id];
+    std::unique_lock<std::mutex> lock(worker.mutex);
+    int remaining = worker.end - worker.begin;
+    if (remaining <= 0)
+    {
+        return false;
+    }
+    int chunk = this->initial_chunk_size;
+    if (worker.nanoseconds_per_item > 0)
+    {
+        chunk = (int)std::min(TARGET_CHUNK_NANOSECONDS / worker.nanoseconds_per_item, (double)remaining);
+    }
+    // At most half of what is left, so the back half can still be stolen while this chunk runs
+    chunk = std::max(std::min(chunk, remaining / 2), 1);
+    begin = worker.begin;
+    end = begin + chunk;
+    worker.begin = end;
+    return true;
+}
+
+bool WorkStealingPool::steal(int id)
+{
+    int num_workers = this->workers.size();
+    for (int offset = 1; offset < num_workers; offset++)
+    {
+        Worker &victim = *this->workers[(id + offset) % num_workers];
+        int begin;
+        int end;
+        {
+            std::unique_lock<std::mutex> lock(victim.mutex);
+            int remaining = victim.end - victim.begin;
+            if (remaining <= 0)
+            {
+                continue;
+            }
+            end = victim.end;
+            begin = end - (remaining + 1) / 2;
+            victim.end = begin;
+        }
+        this->stolen_count += end - begin;
+        // Only the owner adds to its own part, and it is empty, so the stolen items can not overlap anything
+        Worker &thief = *this->workers[id];
+        std::unique_lock<std::mutex> lock(thief.mutex);
+        thief.begin = begin;
+        thief.end = end;
+        return true;
+    }
+    return false;
+}
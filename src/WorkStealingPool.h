@@ -0,0 +1,85 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <exception>
+
+// Persistent workers that split a range of independent items between them, e.g. the fitness evaluations of a generation
+// Every worker owns a contiguous part of the range, its deque. It takes chunks from the front, and once it is empty it
+// steals the back half of another worker's part, so a few expensive items do not leave the other workers idle
+// The chunk size follows the measured cost of the items of each worker, about TARGET_CHUNK_NANOSECONDS of work per chunk
+// Submitting a range does not allocate, the body is passed by reference and called through a function pointer
+class WorkStealingPool
+{
+public:
+    // initial_chunk_size is used until a worker has measured the cost of its items
+    WorkStealingPool(int num_threads, int initial_chunk_size = 1);
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    // Calls body(begin, end) on the workers for disjoint ranges that cover [0, count), and returns once all of them are done
+    // The first exception thrown by body is rethrown here, after the other ranges are done
+    template <typename Body>
+    void parallelFor(int count, const Body &body);
+
+    int size() const;
+    // Items that were stolen during the last parallelFor
+    long getStolenCount() const;
+
+    static constexpr double TARGET_CHUNK_NANOSECONDS = 50000;
+
+private:
+    using Invoker = void (*)(const void *body, int begin, int end);
+
+    struct alignas(64) Worker
+    {
+        // Guards begin and end, the owner and the thieves lock it
+        std::mutex mutex;
+        int begin = 0;
+        int end = 0;
+        // Moving average of the cost of the items of this worker, 0 until measured. Only used by the owner
+        double nanoseconds_per_item = 0;
+        std::thread thread;
+    };
+
+    void run(int count, const void *body, Invoker invoker);
+    void workerLoop(int id);
+    // Works on the items of this worker and the ones it can steal, until there are none left
+    void work(int id);
+    // Takes a chunk from the front of the worker's own part, false if it is empty
+    bool takeChunk(int id, int &begin, int &end);
+    // Moves the back half of another worker's part into the worker's own part, false if every part is empty
+    bool steal(int id);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    int initial_chunk_size;
+
+    // Guards the fields below, workers wait on start_work between runs and the caller on work_done
+    std::mutex mutex;
+    std::condition_variable start_work;
+    std::condition_variable work_done;
+    long generation = 0;
+    bool stopping = false;
+    // Workers that have not finished the current run
+    int busy_workers = 0;
+    std::exception_ptr error;
+
+    // The body of the current run, set before the workers are woken up
+    const void *body = nullptr;
+    Invoker invoker = nullptr;
+    std::atomic<long> stolen_count;
+};
+
+template <typename Body>
+void WorkStealingPool::parallelFor(int count, const Body &body)
+{
+    run(count, &body, [](const void *erased_body, int begin, int end)
+        { (*static_cast<const Body *>(erased_body))(begin, end); });
+}
+#endif
\ No newline at end of file
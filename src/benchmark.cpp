@@ -0,0 +1,2195 @@
+// operator new and delete are replaced below to count allocations. Once they are inlined GCC pairs the malloc of one
+// with the free of the other and warns about a mismatch that is not there
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <memory>
+#include <string>
+#include "Dual.h"
+#include "Link.h"
+#include "CouplerHead.h"
+#include "FourBarMechanism.h"
+#include "Field.h"
+#include "StaticField.h"
+#include "CouplerCurve.h"
+#include "CycleEvaluation.h"
+#include "MechanismBatch.h"
+#include "Optimizer.h"
+#include "FitnessCache.h"
+#include "WorkStealingPool.h"
+#include "ctpl_stl.h"
+
+constexpr double std_mass_linear_density = 1.0; // Kg/m
+constexpr double PI = 3.14159265358979323846;
+
+// Every allocation of the program is counted, so a benchmark can check that a loop does not allocate
+static std::atomic<long> allocation_count(0);
+
+void *operator new(std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size == 0 ? 1 : size))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t size) noexcept
+{
+    std::free(pointer);
+}
+
+// Random mechanisms inside the same limits used by optimize.cpp
+// The points are drawn in double, so every scalar type gets the same mechanisms
+template <typename Scalar = double>
+std::vector<BasicFourBarMechanism<Scalar>> generateMechanisms(int count, unsigned int seed)
+{
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<> ground(0.0, 0.3048);
+    std::uniform_real_distribution<> free_point(0.0, 0.6096);
+    std::vector<BasicFourBarMechanism<Scalar>> mechanisms;
+    mechanisms.reserve(count);
+    for (int i = 0; i < count; i++)
+    {
+        auto input_ground_point = std::make_tuple(Scalar(ground(engine)), Scalar(ground(engine)));
+        auto input_coupler_point = std::make_tuple(Scalar(free_point(engine)), Scalar(free_point(engine)));
+        auto coupler_output_point = std::make_tuple(Scalar(free_point(engine)), Scalar(free_point(engine)));
+        auto output_ground_point = std::make_tuple(Scalar(ground(engine)), Scalar(ground(engine)));
+        auto couplertop_input_point = std::make_tuple(Scalar(free_point(engine)), Scalar(free_point(engine)));
+        auto couplertop_output_point = std::make_tuple(Scalar(free_point(engine)), Scalar(free_point(engine)));
+        BasicLink<Scalar> input_link = BasicLink<Scalar>(input_ground_point, input_coupler_point, std_mass_linear_density);
+        BasicLink<Scalar> coupler_link = BasicLink<Scalar>(input_coupler_point, coupler_output_point, std_mass_linear_density);
+        BasicLink<Scalar> output_link = BasicLink<Scalar>(coupler_output_point, output_ground_point, std_mass_linear_density);
+        BasicCouplerHead<Scalar> coupler_head = BasicCouplerHead<Scalar>(input_link, output_link, couplertop_input_point, couplertop_output_point, std_mass_linear_density);
+        mechanisms.push_back(BasicFourBarMechanism<Scalar>(input_link, coupler_link, output_link, coupler_head));
+    }
+    return mechanisms;
+}
+
+double distance(std::tuple<double, double> a, std::tuple<double, double> b)
+{
+    return std::hypot(std::get<0>(a) - std::get<0>(b), std::get<1>(a) - std::get<1>(b));
+}
+
+// Correctness checks that failed, main returns non-zero if there are any
+int failed_checks = 0;
+
+// The benchmarks print their numbers either way, a failed check adds a line naming it
+void check(bool passed, const std::string &description)
+{
+    if (!passed)
+    {
+        failed_checks++;
+        std::cout << "CHECK FAILED: " << description << "\n";
+    }
+}
+
+// A linkage in long double, the reference the double kinematics are measured against
+// Built from the assembled pose like MechanismBatch::addMechanism, so nothing of a later move leaks into it
+struct ReferenceLinkage
+{
+    long double ground_x;
+    long double ground_y;
+    long double output_ground_x;
+    long double output_ground_y;
+    long double input_length;
+    long double coupler_length;
+    long double output_length;
+    // Top points in the coupler frame, whose origin is the crank pin and whose x axis points to the output pin
+    long double crank_top_along;
+    long double crank_top_across;
+    long double output_top_along;
+    long double output_top_across;
+
+    explicit ReferenceLinkage(const FourBarMechanism &mechanism)
+    {
+        auto [input_ground, crank_pin] = mechanism.getInputLinkPositions();
+        auto [output_pin, output_ground] = mechanism.getOutputLinkPositions();
+        auto [crank_top, output_top] = mechanism.getCouplerHeadTopPositions();
+        long double xc = std::get<0>(crank_pin);
+        long double yc = std::get<1>(crank_pin);
+        long double xo = std::get<0>(output_pin);
+        long double yo = std::get<1>(output_pin);
+        ground_x = std::get<0>(input_ground);
+        ground_y = std::get<1>(input_ground);
+        output_ground_x = std::get<0>(output_ground);
+        output_ground_y = std::get<1>(output_ground);
+        input_length = std::hypot(xc - ground_x, yc - ground_y);
+        coupler_length = std::hypot(xo - xc, yo - yc);
+        output_length = std::hypot(output_ground_x - xo, output_ground_y - yo);
+        long double ux = (xo - xc) / coupler_length;
+        long double uy = (yo - yc) / coupler_length;
+        crank_top_along = (std::get<0>(crank_top) - xc) * ux + (std::get<1>(crank_top) - yc) * uy;
+        crank_top_across = -(std::get<0>(crank_top) - xc) * uy + (std::get<1>(crank_top) - yc) * ux;
+        output_top_along = (std::get<0>(output_top) - xc) * ux + (std::get<1>(output_top) - yc) * uy;
+        output_top_across = -(std::get<0>(output_top) - xc) * uy + (std::get<1>(output_top) - yc) * ux;
+    }
+
+    // Largest distance of the output pin and the top points from their place with the crank at the angle,
+    // on the branch whose output pin is closest to the given one. Only meant for angles where the linkage closes
+    double getPoseError(double angle, std::tuple<double, double> output_pin, std::tuple<std::tuple<double, double>, std::tuple<double, double>> top_positions) const
+    {
+        long double x1 = ground_x + input_length * std::cos((long double)angle);
+        long double y1 = ground_y + input_length * std::sin((long double)angle);
+        long double dx = output_ground_x - x1;
+        long double dy = output_ground_y - y1;
+        long double R = std::hypot(dx, dy);
+        long double along = (coupler_length * coupler_length - output_length * output_length + R * R) / (2 * R);
+        long double across = std::sqrt(std::max((long double)0, coupler_length * coupler_length - along * along));
+        double error = std::numeric_limits<double>::infinity();
+        double closest_pin_error = std::numeric_limits<double>::infinity();
+        for (long double side : {(long double)1, (long double)-1})
+        {
+            long double xo = x1 + (along * dx - side * across * dy) / R;
+            long double yo = y1 + (along * dy + side * across * dx) / R;
+            long double ux = (xo - x1) / coupler_length;
+            long double uy = (yo - y1) / coupler_length;
+            auto pointError = [](long double x, long double y, std::tuple<double, double> point)
+            {
+                return (double)std::hypot(x - std::get<0>(point), y - std::get<1>(point));
+            };
+            double pin_error = pointError(xo, yo, output_pin);
+            double crank_top_error = pointError(x1 + crank_top_along * ux - crank_top_across * uy, y1 + crank_top_along * uy + crank_top_across * ux, std::get<0>(top_positions));
+            double output_top_error = pointError(x1 + output_top_along * ux - output_top_across * uy, y1 + output_top_along * uy + output_top_across * ux, std::get<1>(top_positions));
+            if (pin_error < closest_pin_error)
+            {
+                closest_pin_error = pin_error;
+                error = std::max({pin_error, crank_top_error, output_top_error});
+            }
+        }
+        return error;
+    }
+};
+
+// Compares MechanismBatch::rotateAll against the per-object FourBarMechanism::rotate loop
+void benchmarkBatch(int count, double angle_step)
+{
+    std::cout << "== MechanismBatch::rotateAll vs FourBarMechanism::rotate (" << count << " mechanisms, step " << angle_step << ") ==\n";
+    std::vector<FourBarMechanism> mechanisms = generateMechanisms(count, 42);
+    MechanismBatch batch(mechanisms);
+    std::vector<ReferenceLinkage> references(mechanisms.begin(), mechanisms.end());
+
+    // Accuracy of a single step. Both paths start from the assembled pose and go straight to the angle
+    double max_step_error = 0;
+    double max_rotate_step_error = 0;
+    long feasibility_mismatches = 0;
+    for (double angle = 0; angle < 2 * PI; angle += angle_step)
+    {
+        MechanismBatch step_batch(mechanisms);
+        step_batch.rotateAll(angle);
+        for (int i = 0; i < count; i++)
+        {
+            FourBarMechanism mechanism = mechanisms[i];
+            if (std::abs(angle - mechanism.getAngle()) < 0.00001)
+            {
+                // rotate ignores moves this small, the batch does not
+                continue;
+            }
+            bool moved = true;
+            try
+            {
+                mechanism.rotate(angle, 0.01);
+            }
+            catch (...)
+            {
+                moved = false;
+            }
+            if (moved != step_batch.isFeasible(i))
+            {
+                feasibility_mismatches++;
+            }
+            else if (moved)
+            {
+                max_step_error = std::max(max_step_error, references[i].getPoseError(angle, step_batch.getOutputPinPosition(i), step_batch.getCouplerHeadTopPositions(i)));
+                max_rotate_step_error = std::max(max_rotate_step_error, references[i].getPoseError(angle, std::get<0>(mechanism.getOutputLinkPositions()), mechanism.getCouplerHeadTopPositions()));
+            }
+        }
+    }
+    std::cout << "Max single step position error against long double: rotateAll " << max_step_error << " m, rotate " << max_rotate_step_error
+              << " m, feasibility mismatches: " << feasibility_mismatches << "\n";
+    check(max_step_error <= 1e-12, "rotateAll single step error above 1e-12 m");
+    check(feasibility_mismatches == 0, "rotateAll and rotate disagree on feasibility");
+
+    // Both paths stepping through a whole revolution. rotateAll places every pose from the angle and the lengths it stored,
+    // rotate re-measures its link lengths at every step, so only rotate drifts, mostly close to the toggle positions
+    double max_drift = 0;
+    double max_revolution_error = 0;
+    double max_rotate_revolution_error = 0;
+    for (double angle = 0; angle < 2 * PI; angle += angle_step)
+    {
+        batch.rotateAll(angle);
+        for (int i = 0; i < count; i++)
+        {
+            try
+            {
+                mechanisms[i].rotate(angle, 0.01);
+            }
+            catch (...)
+            {
+                continue;
+            }
+            if (batch.isFeasible(i))
+            {
+                auto [top1, top2] = mechanisms[i].getCouplerHeadTopPositions();
+                auto [batch_top1, batch_top2] = batch.getCouplerHeadTopPositions(i);
+                max_drift = std::max({max_drift, distance(top1, batch_top1), distance(top2, batch_top2)});
+                max_revolution_error = std::max(max_revolution_error, references[i].getPoseError(angle, batch.getOutputPinPosition(i), batch.getCouplerHeadTopPositions(i)));
+                max_rotate_revolution_error = std::max(max_rotate_revolution_error, references[i].getPoseError(angle, std::get<0>(mechanisms[i].getOutputLinkPositions()), mechanisms[i].getCouplerHeadTopPositions()));
+            }
+        }
+    }
+    std::cout << "Max position error over a full revolution against long double: rotateAll " << max_revolution_error << " m, rotate " << max_rotate_revolution_error
+              << " m, difference between the two " << max_drift << " m\n";
+    check(max_revolution_error <= 1e-12, "rotateAll error over a full revolution above 1e-12 m");
+
+    // Throughput
+    std::vector<FourBarMechanism> fresh = generateMechanisms(count, 7);
+    long steps = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (double angle = 0; angle < 2 * PI; angle += angle_step)
+    {
+        for (FourBarMechanism &mechanism : fresh)
+        {
+            try
+            {
+                mechanism.rotate(angle, 0.01);
+            }
+            catch (...)
+            {
+            }
+        }
+        steps++;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double scalar_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    MechanismBatch fresh_batch(generateMechanisms(count, 7));
+    long feasible_poses = 0;
+    start = std::chrono::steady_clock::now();
+    for (double angle = 0; angle < 2 * PI; angle += angle_step)
+    {
+        feasible_poses += fresh_batch.rotateAll(angle);
+    }
+    end = std::chrono::steady_clock::now();
+    double batch_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    double poses = (double)steps * count;
+    std::cout << "Per-object rotate: " << scalar_seconds << " seconds (" << poses / scalar_seconds / 1e6 << " M poses/s)\n";
+    std::cout << "Batch rotateAll:   " << batch_seconds << " seconds (" << poses / batch_seconds / 1e6 << " M poses/s, "
+              << feasible_poses / poses * 100 << "% feasible)\n";
+    std::cout << "Speedup: " << scalar_seconds / batch_seconds << "x\n\n";
+}
+
+// Cost of reporting infeasible angles with an exception versus a status code
+void benchmarkTryRotate(int count, double angle_step)
+{
+    std::cout << "== FourBarMechanism::tryRotate vs rotate with catch (" << count << " mechanisms, step " << angle_step << ") ==\n";
+    std::vector<FourBarMechanism> throwing = generateMechanisms(count, 7);
+    long infeasible = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (FourBarMechanism &mechanism : throwing)
+    {
+        for (double angle = 0; angle < 2 * PI; angle += angle_step)
+        {
+            try
+            {
+                mechanism.rotate(angle, 0.01);
+            }
+            catch (...)
+            {
+                infeasible++;
+            }
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double throwing_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    std::vector<FourBarMechanism> non_throwing = generateMechanisms(count, 7);
+    long status_infeasible = 0;
+    start = std::chrono::steady_clock::now();
+    for (FourBarMechanism &mechanism : non_throwing)
+    {
+        for (double angle = 0; angle < 2 * PI; angle += angle_step)
+        {
+            if (mechanism.tryRotate(angle, 0.01) == RotationStatus::Infeasible)
+            {
+                status_infeasible++;
+            }
+        }
+    }
+    end = std::chrono::steady_clock::now();
+    double status_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    std::cout << "rotate + catch: " << throwing_seconds << " seconds (" << infeasible << " exceptions)\n";
+    std::cout << "tryRotate:      " << status_seconds << " seconds (" << status_infeasible << " infeasible angles)\n";
+    std::cout << "Speedup: " << throwing_seconds / status_seconds << "x\n\n";
+}
+
+// Rotation recurrence sweep versus calling tryRotate at every angle
+void benchmarkSweep(int count, double angle_step)
+{
+    std::cout << "== FourBarMechanism::sweep vs tryRotate loop (" << count << " mechanisms, step " << angle_step << ") ==\n";
+    std::vector<FourBarMechanism> looped = generateMechanisms(count, 11);
+    std::vector<std::tuple<double, double>> loop_positions;
+    auto start = std::chrono::steady_clock::now();
+    for (FourBarMechanism &mechanism : looped)
+    {
+        for (long step = 0; step * angle_step <= 2 * PI; step++)
+        {
+            mechanism.tryRotate(step * angle_step, 0.01);
+            loop_positions.push_back(std::get<0>(mechanism.getCouplerHeadTopPositions()));
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double loop_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    std::vector<FourBarMechanism> swept = generateMechanisms(count, 11);
+    std::vector<std::tuple<double, double>> sweep_positions;
+    start = std::chrono::steady_clock::now();
+    for (FourBarMechanism &mechanism : swept)
+    {
+        mechanism.sweep(0, 2 * PI, angle_step, 0.01, [&](FourBarMechanism &moved, RotationStatus status)
+                        { sweep_positions.push_back(std::get<0>(moved.getCouplerHeadTopPositions())); });
+    }
+    end = std::chrono::steady_clock::now();
+    double sweep_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    double max_error = 0;
+    for (size_t i = 0; i < std::min(loop_positions.size(), sweep_positions.size()); i++)
+    {
+        max_error = std::max(max_error, distance(loop_positions[i], sweep_positions[i]));
+    }
+    std::cout << "Samples: " << loop_positions.size() << " vs " << sweep_positions.size() << ", max coupler top difference: " << max_error << " m\n";
+    check(loop_positions.size() == sweep_positions.size() && max_error <= 1e-10, "sweep differs from the tryRotate loop");
+    std::cout << "tryRotate loop: " << loop_seconds << " seconds\n";
+    std::cout << "sweep:          " << sweep_seconds << " seconds\n";
+    std::cout << "Speedup: " << loop_seconds / sweep_seconds << "x\n\n";
+}
+
+// Button hits and number of steps of adaptiveSweep versus a fixed step sweep
+// Every mechanism gets a field with hitboxes placed on its own coupler curve
+void benchmarkAdaptiveSweep(int count, double angle_step, double hitbox_radius)
+{
+    std::cout << "== FourBarMechanism::adaptiveSweep vs fixed step sweep (" << count << " mechanisms, step " << angle_step << ", hitbox " << hitbox_radius << ") ==\n";
+    std::vector<FourBarMechanism> mechanisms = generateMechanisms(count, 13);
+    std::mt19937 engine(17);
+    std::uniform_real_distribution<> offset(-hitbox_radius, hitbox_radius);
+    long fixed_steps = 0;
+    long adaptive_steps = 0;
+    long fixed_hits = 0;
+    long adaptive_hits = 0;
+    long fixed_only = 0;
+    long adaptive_only = 0;
+    double fixed_seconds = 0;
+    double adaptive_seconds = 0;
+    for (FourBarMechanism &mechanism : mechanisms)
+    {
+        std::vector<AngleInterval> intervals = mechanism.getFeasibleAngleIntervals();
+        if (intervals.empty())
+        {
+            continue;
+        }
+        // Three button pairs around poses of the mechanism itself
+        Field field;
+        for (int i = 0; i < 3; i++)
+        {
+            const AngleInterval &interval = intervals[engine() % intervals.size()];
+            double angle = interval.start + (interval.end - interval.start) * std::uniform_real_distribution<>(0, 1)(engine);
+            FourBarMechanism posed = mechanism;
+            posed.tryRotate(angle, 0.01);
+            auto [crank_top, output_top] = posed.getCouplerHeadTopPositions();
+            field.addButtonPair(ButtonPair{std::get<0>(crank_top) + offset(engine), std::get<1>(crank_top) + offset(engine), hitbox_radius,
+                                           std::get<0>(output_top) + offset(engine), std::get<1>(output_top) + offset(engine), hitbox_radius});
+        }
+
+        bool fixed_pressed[3] = {false, false, false};
+        bool adaptive_pressed[3] = {false, false, false};
+        // Every interval is swept from the initial pose, so both sweeps enter it on the same assembly branch
+        auto start = std::chrono::steady_clock::now();
+        for (const AngleInterval &interval : intervals)
+        {
+            FourBarMechanism fixed = mechanism;
+            fixed.sweep(interval.start, interval.end, angle_step, 0.01, [&](FourBarMechanism &moved, RotationStatus status)
+                        {
+                fixed_steps++;
+                auto [pos1, pos2] = moved.getCouplerHeadTopPositions();
+                int index = field.getButtonPairPressedIndex(pos1, pos2);
+                if (status != RotationStatus::Infeasible && index != -1)
+                {
+                    fixed_pressed[index] = true;
+                } });
+        }
+        auto end = std::chrono::steady_clock::now();
+        fixed_seconds += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+        start = std::chrono::steady_clock::now();
+        for (const AngleInterval &interval : intervals)
+        {
+            FourBarMechanism adaptive = mechanism;
+            adaptive.adaptiveSweep(interval.start, interval.end, field, angle_step / 0.01, [&](FourBarMechanism &moved, RotationStatus status)
+                                   {
+                adaptive_steps++;
+                auto [pos1, pos2] = moved.getCouplerHeadTopPositions();
+                int index = field.getButtonPairPressedIndex(pos1, pos2);
+                if (status != RotationStatus::Infeasible && index != -1)
+                {
+                    adaptive_pressed[index] = true;
+                } });
+        }
+        end = std::chrono::steady_clock::now();
+        adaptive_seconds += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+        for (int i = 0; i < 3; i++)
+        {
+            fixed_hits += fixed_pressed[i];
+            adaptive_hits += adaptive_pressed[i];
+            fixed_only += fixed_pressed[i] && !adaptive_pressed[i];
+            adaptive_only += adaptive_pressed[i] && !fixed_pressed[i];
+        }
+    }
+    std::cout << "Fixed step: " << fixed_hits << " buttons pressed, " << fixed_steps << " steps, " << fixed_seconds << " seconds\n";
+    std::cout << "Adaptive:   " << adaptive_hits << " buttons pressed, " << adaptive_steps << " steps, " << adaptive_seconds << " seconds\n";
+    std::cout << "Buttons detected only by the fixed step: " << fixed_only << ", only by the adaptive step: " << adaptive_only << "\n";
+    std::cout << "Steps ratio: " << (double)fixed_steps / adaptive_steps << "x\n\n";
+}
+
+// The energy at a crank angle should not depend on the step used to get there
+void benchmarkEnergy(int count, double angular_speed)
+{
+    std::cout << "== FourBarMechanism::getTotalEnergy with fine and coarse sweeps (" << count << " mechanisms, " << angular_speed << " rad/s) ==\n";
+    std::vector<FourBarMechanism> mechanisms = generateMechanisms(count, 23);
+    double fine_step = 0.001;
+    double coarse_step = 0.1;
+    double max_difference = 0;
+    int compared = 0;
+    int branch_jumps = 0;
+    for (const FourBarMechanism &mechanism : mechanisms)
+    {
+        std::vector<AngleInterval> intervals = mechanism.getFeasibleAngleIntervals();
+        if (intervals.empty() || intervals[0].end - intervals[0].start < 2 * coarse_step)
+        {
+            continue;
+        }
+        // A probe angle both sweeps land on
+        double end = intervals[0].start + coarse_step * std::floor((intervals[0].end - intervals[0].start) / 2 / coarse_step) + fine_step / 2;
+        double energies[2] = {0, 0};
+        std::tuple<double, double> pins[2];
+        double steps[2] = {fine_step, coarse_step};
+        for (int i = 0; i < 2; i++)
+        {
+            FourBarMechanism swept = mechanism;
+            swept.sweep(intervals[0].start, end, steps[i], steps[i] / angular_speed, [&](FourBarMechanism &moved, RotationStatus status)
+                        { energies[i] = moved.getTotalEnergy(); });
+            pins[i] = std::get<0>(swept.getOutputLinkPositions());
+        }
+        // Large steps can pick the pin joint of the other assembly branch, that is a different pose
+        if (distance(pins[0], pins[1]) > 1e-9)
+        {
+            branch_jumps++;
+            continue;
+        }
+        max_difference = std::max(max_difference, std::abs(energies[0] - energies[1]) / std::abs(energies[0]));
+        compared++;
+    }
+    std::cout << "Max relative energy difference between steps " << fine_step << " and " << coarse_step << " over " << compared << " mechanisms: " << max_difference << "\n";
+    check(max_difference <= 1e-9, "energy depends on the step size");
+    std::cout << "Skipped " << branch_jumps << " mechanisms where the coarse sweep ended on the other assembly branch\n\n";
+}
+
+// Cost of the energy in a sweep, read at every step or never
+void benchmarkLazyEnergy(int count, double angle_step)
+{
+    std::cout << "== FourBarMechanism::sweep with and without reading the energy (" << count << " mechanisms, step " << angle_step << ") ==\n";
+    std::vector<FourBarMechanism> mechanisms = generateMechanisms(count, 29);
+    double seconds[2] = {0, 0};
+    double checksum = 0;
+    // Poses at the ends of the feasible intervals are dead points, their energy is NaN
+    int dead_points = 0;
+    for (int read_energy = 0; read_energy < 2; read_energy++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (const FourBarMechanism &mechanism : mechanisms)
+        {
+            FourBarMechanism swept = mechanism;
+            for (const AngleInterval &interval : swept.getFeasibleAngleIntervals())
+            {
+                swept.sweep(interval.start, interval.end, angle_step, 0.01, [&](FourBarMechanism &moved, RotationStatus status)
+                            {
+                    auto [crank_top, output_top] = moved.getCouplerHeadTopPositions();
+                    checksum += std::get<0>(crank_top);
+                    if (read_energy && status == RotationStatus::Moved)
+                    {
+                        double energy = moved.getTotalEnergy();
+                        if (std::isnan(energy))
+                        {
+                            dead_points++;
+                        }
+                        else
+                        {
+                            checksum += energy;
+                        }
+                    } });
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        seconds[read_energy] = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+    }
+    std::cout << "Positions only:        " << seconds[0] << " seconds\n";
+    std::cout << "Energy at every step:  " << seconds[1] << " seconds (checksum " << checksum << ", " << dead_points << " dead points)\n";
+    std::cout << "Saved by not reading the energy: " << (1 - seconds[0] / seconds[1]) * 100 << "%\n\n";
+}
+
+// Same terms as fitnessFunction in optimize.cpp, without the printing
+template <typename Scalar>
+double fitness(BasicFourBarMechanism<Scalar> mechanism, Field &playing_field, int &buttons_pressed)
+{
+    Scalar angle_step = 0.001;
+    Scalar dt = 0.01;
+    bool was_button_pressed[3] = {false, false, false};
+    std::vector<double> energies;
+    BasicFourBarMechanism<Scalar> energy_probe = mechanism;
+    for (long count = 0; count < 2; count++)
+    {
+        if (energy_probe.tryRotate(count * angle_step, dt) != RotationStatus::Infeasible)
+        {
+            double energy = static_cast<double>(energy_probe.getTotalEnergy());
+            if (!std::isnan(energy) && !std::isnan(-energy))
+            {
+                energies.push_back(energy);
+            }
+        }
+    }
+    for (const AngleInterval &interval : mechanism.getFeasibleAngleIntervals())
+    {
+        mechanism.sweep(Scalar(interval.start), Scalar(interval.end), angle_step, dt, [&](BasicFourBarMechanism<Scalar> &moved, RotationStatus status)
+                        {
+            if (status != RotationStatus::Infeasible)
+            {
+                auto [pos1, pos2] = moved.getCouplerHeadTopPositions();
+                int button_index = playing_field.getButtonPairPressedIndex(pos1, pos2);
+                if (button_index != -1)
+                {
+                    was_button_pressed[button_index] = true;
+                }
+            } });
+    }
+    double energy_mean = std::accumulate(energies.begin(), energies.end(), 0.0) / energies.size();
+    double deviation = 0;
+    for (double energy : energies)
+    {
+        deviation += std::abs(energy - energy_mean) / energies.size();
+    }
+    double result = std::isnan(deviation) ? 0 : deviation;
+    result -= energies.size() * 1000;
+    buttons_pressed = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        buttons_pressed += was_button_pressed[i];
+        result += was_button_pressed[i] ? 0 : 1000;
+    }
+    return result;
+}
+
+// Throughput and accuracy of the optimize.cpp fitness with float instead of double
+void benchmarkFloatFitness(int count)
+{
+    std::cout << "== optimize.cpp fitness with BasicFourBarMechanism<float> vs <double> (" << count << " mechanisms) ==\n";
+    double hitbox_radius = 0.0142 / 1.41421356237;
+    Field playing_field({ButtonPair{0.1143, 0.3429, hitbox_radius, 0.163322, 0.329692, hitbox_radius}, ButtonPair{0.254, 0.381, hitbox_radius, 0.3048, 0.381, hitbox_radius}, ButtonPair{0.408686, 0.315214, hitbox_radius, 0.4445, 0.2794, hitbox_radius}});
+    std::vector<FourBarMechanism> doubles = generateMechanisms<double>(count, 31);
+    std::vector<BasicFourBarMechanism<float>> floats = generateMechanisms<float>(count, 31);
+
+    std::vector<double> double_fitness(count);
+    std::vector<double> float_fitness(count);
+    std::vector<int> double_buttons(count);
+    std::vector<int> float_buttons(count);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        double_fitness[i] = fitness(doubles[i], playing_field, double_buttons[i]);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double double_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        float_fitness[i] = fitness(floats[i], playing_field, float_buttons[i]);
+    }
+    end = std::chrono::steady_clock::now();
+    double float_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    double max_difference = 0;
+    int button_mismatches = 0;
+    for (int i = 0; i < count; i++)
+    {
+        max_difference = std::max(max_difference, std::abs(double_fitness[i] - float_fitness[i]) / std::max(1.0, std::abs(double_fitness[i])));
+        button_mismatches += double_buttons[i] != float_buttons[i];
+    }
+
+    // Coupler top positions along a plain sweep
+    double max_position_error = 0;
+    int branch_flips = 0;
+    for (int i = 0; i < count; i++)
+    {
+        std::vector<AngleInterval> intervals = doubles[i].getFeasibleAngleIntervals();
+        if (intervals.empty())
+        {
+            continue;
+        }
+        FourBarMechanism swept_double = doubles[i];
+        BasicFourBarMechanism<float> swept_float = floats[i];
+        for (double angle = intervals[0].start; angle <= intervals[0].end; angle += 0.01)
+        {
+            if (swept_double.tryRotate(angle, 0.01) != RotationStatus::Moved || swept_float.tryRotate(angle, 0.01f) != RotationStatus::Moved)
+            {
+                continue;
+            }
+            auto [double_top, double_other_top] = swept_double.getCouplerHeadTopPositions();
+            auto [float_top, float_other_top] = swept_float.getCouplerHeadTopPositions();
+            // Near a dead point the float error grows quickly and the two precisions can pick different assembly branches
+            double error = distance(double_top, float_top);
+            if (error > 0.001)
+            {
+                branch_flips++;
+                break;
+            }
+            max_position_error = std::max(max_position_error, error);
+        }
+    }
+    std::cout << "double: " << double_seconds << " seconds, float: " << float_seconds << " seconds, speedup " << double_seconds / float_seconds << "x\n";
+    std::cout << "Max relative fitness difference: " << max_difference << ", mechanisms with a different number of buttons pressed: " << button_mismatches << "\n";
+    std::cout << "Max coupler top difference over the first feasible interval: " << max_position_error << " m, mechanisms that drifted more than 1 mm near a dead point: " << branch_flips << "\n";
+
+    // Dual numbers give the derivative of the coupler top with respect to the crank angle
+    double max_derivative_error = 0;
+    int compared = 0;
+    std::vector<BasicFourBarMechanism<Dual<double>>> duals = generateMechanisms<Dual<double>>(count, 31);
+    for (int i = 0; i < count; i++)
+    {
+        std::vector<AngleInterval> intervals = doubles[i].getFeasibleAngleIntervals();
+        if (intervals.empty())
+        {
+            continue;
+        }
+        double angle = (intervals[0].start + intervals[0].end) / 2;
+        double h = 1e-4;
+        FourBarMechanism ahead = doubles[i];
+        FourBarMechanism behind = doubles[i];
+        if (duals[i].tryRotate(Dual<double>(angle, 1), 0.01) != RotationStatus::Moved || ahead.tryRotate(angle + h, 0.01) != RotationStatus::Moved || behind.tryRotate(angle - h, 0.01) != RotationStatus::Moved)
+        {
+            continue;
+        }
+        Dual<double> x = std::get<0>(std::get<0>(duals[i].getCouplerHeadTopPositions()));
+        double centered = (std::get<0>(std::get<0>(ahead.getCouplerHeadTopPositions())) + std::get<0>(std::get<0>(behind.getCouplerHeadTopPositions()))) / 2;
+        if (std::abs(x.value - centered) > 1e-6)
+        {
+            // The differences landed on another branch
+            continue;
+        }
+        compared++;
+        double numeric = (std::get<0>(std::get<0>(ahead.getCouplerHeadTopPositions())) - std::get<0>(std::get<0>(behind.getCouplerHeadTopPositions()))) / (2 * h);
+        max_derivative_error = std::max(max_derivative_error, std::abs(x.derivative - numeric) / std::max(1.0, std::abs(numeric)));
+    }
+    std::cout << "Max difference between the Dual<double> and the central difference derivative of the coupler top: " << max_derivative_error << " over " << compared << " mechanisms\n\n";
+    check(max_derivative_error <= 1e-4, "Dual<double> derivative differs from the central difference");
+}
+
+// Both assembly branches from one circle intersection per step, against a sweep of the branch the mechanism is on
+void benchmarkBothBranches(int count, double angle_step)
+{
+    std::cout << "== FourBarMechanism::sweepBothBranches vs sweep (" << count << " mechanisms, step " << angle_step << ") ==\n";
+    std::vector<FourBarMechanism> mechanisms = generateMechanisms(count, 41);
+    // Every mechanism starts at the beginning of its first feasible interval
+    std::vector<AngleInterval> intervals;
+    std::vector<FourBarMechanism> started;
+    for (FourBarMechanism &mechanism : mechanisms)
+    {
+        std::vector<AngleInterval> feasible = mechanism.getFeasibleAngleIntervals();
+        if (!feasible.empty() && mechanism.tryRotate(feasible[0].start, 0.01) != RotationStatus::Infeasible)
+        {
+            intervals.push_back(feasible[0]);
+            started.push_back(mechanism);
+        }
+    }
+
+    std::vector<std::tuple<double, double>> sweep_positions;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < started.size(); i++)
+    {
+        FourBarMechanism mechanism = started[i];
+        mechanism.sweep(intervals[i].start, intervals[i].end, angle_step, 0.01, [&](FourBarMechanism &moved, RotationStatus status)
+                        {
+            if (status != RotationStatus::Infeasible)
+            {
+                sweep_positions.push_back(std::get<0>(moved.getCouplerHeadTopPositions()));
+            } });
+    }
+    auto end = std::chrono::steady_clock::now();
+    double sweep_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    std::vector<std::tuple<double, double>> branch_positions[2];
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < started.size(); i++)
+    {
+        started[i].sweepBothBranches(intervals[i].start, intervals[i].end, angle_step, [&](double angle, const FourBarMechanism::TopPositions &positive_tops, const FourBarMechanism::TopPositions &negative_tops)
+                                     {
+            branch_positions[0].push_back(std::get<0>(positive_tops));
+            branch_positions[1].push_back(std::get<0>(negative_tops)); });
+    }
+    end = std::chrono::steady_clock::now();
+    double both_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    // The interval starts at a dead point where both branches meet, the sweep has to stay on the one it leaves it on
+    double max_error = 0;
+    int jumped = 0;
+    size_t sample = 0;
+    for (size_t i = 0; i < started.size(); i++)
+    {
+        size_t samples = 0;
+        started[i].sweepBothBranches(intervals[i].start, intervals[i].end, angle_step, [&](double, const FourBarMechanism::TopPositions &, const FourBarMechanism::TopPositions &)
+                                     { samples++; });
+        double branch_error[2] = {0, 0};
+        for (int branch = 0; branch < 2; branch++)
+        {
+            for (size_t k = sample; k < sample + samples && k < sweep_positions.size(); k++)
+            {
+                branch_error[branch] = std::max(branch_error[branch], distance(sweep_positions[k], branch_positions[branch][k]));
+            }
+        }
+        double mechanism_error = std::min(branch_error[0], branch_error[1]);
+        if (mechanism_error > 1e-6)
+        {
+            jumped++;
+        }
+        else
+        {
+            max_error = std::max(max_error, mechanism_error);
+        }
+        sample += samples;
+    }
+    std::cout << "Samples: " << sweep_positions.size() << " for one branch, " << branch_positions[0].size() + branch_positions[1].size() << " for both\n";
+    std::cout << "Max coupler top difference on the branch the sweep followed: " << max_error << " m, mechanisms whose sweep jumped branch: " << jumped << "\n";
+    check(jumped == 0, "sweepBothBranches lost the branch the sweep followed");
+    std::cout << "sweep, one branch:              " << sweep_seconds << " seconds\n";
+    std::cout << "sweepBothBranches, two branches: " << both_seconds << " seconds\n";
+    std::cout << "Time per branch: " << sweep_seconds / (both_seconds / 2) << "x faster\n\n";
+}
+
+// The optimize.cpp fitness written by hand against the same terms from evaluateCycle
+void benchmarkEvaluateCycle(int count)
+{
+    std::cout << "== evaluateCycle vs hand written fitness loop (" << count << " mechanisms) ==\n";
+    double hitbox_radius = 0.0142 / 1.41421356237;
+    Field playing_field({ButtonPair{0.1143, 0.3429, hitbox_radius, 0.163322, 0.329692, hitbox_radius}, ButtonPair{0.254, 0.381, hitbox_radius, 0.3048, 0.381, hitbox_radius}, ButtonPair{0.408686, 0.315214, hitbox_radius, 0.4445, 0.2794, hitbox_radius}});
+    std::vector<FourBarMechanism> mechanisms = generateMechanisms(count, 53);
+
+    std::vector<double> loop_fitness(count);
+    int buttons_pressed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        loop_fitness[i] = fitness(mechanisms[i], playing_field, buttons_pressed);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double loop_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    std::vector<double> cycle_fitness(count);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        CycleResult cycle = evaluateCycle(mechanisms[i], playing_field);
+        cycle_fitness[i] = cycle.energy_deviation - cycle.energy_samples * 1000 + (3 - cycle.buttons_pressed) * 1000;
+    }
+    end = std::chrono::steady_clock::now();
+    double cycle_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    double max_difference = 0;
+    for (int i = 0; i < count; i++)
+    {
+        max_difference = std::max(max_difference, std::abs(loop_fitness[i] - cycle_fitness[i]));
+    }
+    std::cout << "Max fitness difference: " << max_difference << "\n";
+    check(max_difference <= 1e-9, "evaluateCycle differs from the hand written fitness loop");
+    std::cout << "Hand written loop: " << loop_seconds << " seconds\n";
+    std::cout << "evaluateCycle:     " << cycle_seconds << " seconds\n";
+    std::cout << "Speedup: " << loop_seconds / cycle_seconds << "x\n\n";
+}
+
+// Field queries with the grid against a linear scan, from 3 to 100k button pairs at the same density
+void benchmarkFieldIndex(int queries)
+{
+    std::cout << "== Field grid index vs linear scan (" << queries << " queries per field) ==\n";
+    for (int pair_count : {3, 100, 1000, 10000, 100000})
+    {
+        std::mt19937 engine(61);
+        double side = 0.6096 * std::sqrt(pair_count / 3.0);
+        std::uniform_real_distribution<> position(0.0, side);
+        std::uniform_real_distribution<> offset(-0.05, 0.05);
+        std::uniform_real_distribution<> jitter(-0.015, 0.015);
+        double hitbox_radius = 0.0142 / 1.41421356237;
+        std::vector<ButtonPair> pairs;
+        for (int i = 0; i < pair_count; i++)
+        {
+            double x = position(engine);
+            double y = position(engine);
+            pairs.push_back(ButtonPair{x, y, hitbox_radius, x + offset(engine), y + offset(engine), hitbox_radius});
+        }
+        auto start = std::chrono::steady_clock::now();
+        Field field;
+        for (const ButtonPair &button_pair : pairs)
+        {
+            field.addButtonPair(button_pair);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double build_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+        // Half of the queries land close to a pair, the other half anywhere. Like on a coupler head, the second point
+        // is always near the first
+        std::vector<std::tuple<double, double>> first_points;
+        std::vector<std::tuple<double, double>> second_points;
+        std::uniform_int_distribution<> pick(0, pair_count - 1);
+        for (int i = 0; i < queries; i++)
+        {
+            if (i % 2 == 0)
+            {
+                const ButtonPair &button_pair = pairs[pick(engine)];
+                first_points.push_back(std::make_tuple(button_pair.x1 + jitter(engine), button_pair.y1 + jitter(engine)));
+                second_points.push_back(std::make_tuple(button_pair.x2 + jitter(engine), button_pair.y2 + jitter(engine)));
+            }
+            else
+            {
+                double x = position(engine);
+                double y = position(engine);
+                first_points.push_back(std::make_tuple(x, y));
+                second_points.push_back(std::make_tuple(x + offset(engine), y + offset(engine)));
+            }
+        }
+
+        long pressed = 0;
+        double clearance_sum = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < queries; i++)
+        {
+            pressed += field.getButtonPairPressedIndex(first_points[i], second_points[i]) != -1;
+        }
+        end = std::chrono::steady_clock::now();
+        double pressed_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < queries; i++)
+        {
+            clearance_sum += std::min(field.getClearance(first_points[i], second_points[i]), 1.0);
+        }
+        end = std::chrono::steady_clock::now();
+        double clearance_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+        // The linear scan is only run on as many queries as keep it under a second or so
+        int linear_queries = std::min(queries, std::max(1000, 200000000 / (pair_count * 2)));
+        int mismatches = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < linear_queries; i++)
+        {
+            auto [x1, y1] = first_points[i];
+            auto [x2, y2] = second_points[i];
+            int index = -1;
+            double clearance = std::numeric_limits<double>::infinity();
+            for (int k = 0; k < pair_count; k++)
+            {
+                const ButtonPair &button_pair = pairs[k];
+                double distance_1 = std::max(std::abs(x1 - button_pair.x1), std::abs(y1 - button_pair.y1)) - button_pair.r1;
+                double distance_2 = std::max(std::abs(x2 - button_pair.x2), std::abs(y2 - button_pair.y2)) - button_pair.r2;
+                if (index == -1 && distance_1 < 0 && distance_2 < 0)
+                {
+                    index = k;
+                }
+                if (std::max(distance_1, distance_2) >= 0)
+                {
+                    clearance = std::min(clearance, std::max(distance_1, distance_2));
+                }
+            }
+            mismatches += index != field.getButtonPairPressedIndex(first_points[i], second_points[i]) || clearance != field.getClearance(first_points[i], second_points[i]);
+        }
+        end = std::chrono::steady_clock::now();
+        double linear_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+        std::cout << pair_count << " pairs: build " << build_seconds * 1000 << " ms, grid " << pressed_seconds / queries * 1e9 << " ns per pressed query and "
+                  << clearance_seconds / queries * 1e9 << " ns per clearance query, linear scan "
+                  << linear_seconds / linear_queries * 1e9 << " ns for both, " << pressed << " pressed, mean clearance " << clearance_sum / queries << " m, " << mismatches << " mismatches in " << linear_queries << " checked queries\n";
+        check(mismatches == 0, "grid queries differ from the linear scan");
+    }
+    std::cout << "\n";
+}
+
+// Every pressed pair at once with getPressedMask, against testing the pairs one by one on a copy of getButtonPairs
+void benchmarkPressedMask(int queries)
+{
+    std::cout << "== Field::getPressedMask vs testing every pair (" << queries << " queries per field) ==\n";
+    for (int pair_count : {3, 8, 15, 100, 1000, 100000})
+    {
+        std::mt19937 engine(67);
+        double side = 0.6096 * std::sqrt(pair_count / 3.0);
+        std::uniform_real_distribution<> position(0.0, side);
+        std::uniform_real_distribution<> offset(-0.05, 0.05);
+        std::uniform_real_distribution<> jitter(-0.015, 0.015);
+        double hitbox_radius = 0.0142 / 1.41421356237;
+        Field field;
+        for (int i = 0; i < pair_count; i++)
+        {
+            double x = position(engine);
+            double y = position(engine);
+            field.addButtonPair(ButtonPair{x, y, hitbox_radius, x + offset(engine), y + offset(engine), hitbox_radius});
+        }
+        const std::vector<ButtonPair> &pairs = field.getButtonPairs();
+        std::vector<std::tuple<double, double>> first_points;
+        std::vector<std::tuple<double, double>> second_points;
+        std::uniform_int_distribution<> pick(0, pair_count - 1);
+        for (int i = 0; i < queries; i++)
+        {
+            const ButtonPair &button_pair = pairs[pick(engine)];
+            first_points.push_back(std::make_tuple(button_pair.x1 + jitter(engine), button_pair.y1 + jitter(engine)));
+            second_points.push_back(std::make_tuple(button_pair.x2 + jitter(engine), button_pair.y2 + jitter(engine)));
+        }
+
+        std::vector<std::uint64_t> mask;
+        long mask_pressed = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < queries; i++)
+        {
+            field.getPressedMask(first_points[i], second_points[i], mask);
+            for (std::uint64_t word : mask)
+            {
+                mask_pressed += __builtin_popcountll(word);
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        double mask_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+        // The way it had to be done before, a copy of the pairs and a test per pair. Fewer queries for the large fields
+        int scan_queries = std::min(queries, std::max(100, 20000000 / pair_count));
+        long scan_pressed = 0;
+        int mismatches = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < scan_queries; i++)
+        {
+            std::vector<ButtonPair> copied = field.getButtonPairs();
+            auto [x1, y1] = first_points[i];
+            auto [x2, y2] = second_points[i];
+            std::vector<std::uint64_t> scan_mask((pair_count + 63) / 64, 0);
+            for (int k = 0; k < pair_count; k++)
+            {
+                ButtonPair button_pair = copied[k];
+                if (std::abs(x1 - button_pair.x1) < button_pair.r1 && std::abs(y1 - button_pair.y1) < button_pair.r1 &&
+                    std::abs(x2 - button_pair.x2) < button_pair.r2 && std::abs(y2 - button_pair.y2) < button_pair.r2)
+                {
+                    scan_mask[k / 64] |= std::uint64_t(1) << (k % 64);
+                    scan_pressed++;
+                }
+            }
+            field.getPressedMask(first_points[i], second_points[i], mask);
+            mismatches += mask != scan_mask;
+        }
+        end = std::chrono::steady_clock::now();
+        double scan_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+        std::cout << pair_count << " pairs: getPressedMask " << mask_seconds / queries * 1e9 << " ns per query, copy and scan "
+                  << scan_seconds / scan_queries * 1e9 << " ns per query, " << mask_pressed << " pairs pressed, " << mismatches << " mismatches in " << scan_queries << " checked queries\n";
+        check(mismatches == 0, "getPressedMask differs from the scan");
+    }
+    std::cout << "\n";
+}
+
+// Uniform sweeps with coarse steps and the swept hit test, against a fine sweep testing every pose
+void benchmarkSweptHits(int count)
+{
+    std::cout << "== Swept hit test with coarse steps vs pose test at 0.001 rad (" << count << " mechanisms) ==\n";
+    double hitbox_radius = 0.0142 / 1.41421356237;
+    std::vector<FourBarMechanism> mechanisms = generateMechanisms(count, 71);
+    // Three button pairs around poses of each mechanism, like benchmarkAdaptiveSweep
+    std::mt19937 engine(73);
+    std::uniform_real_distribution<> offset(-hitbox_radius, hitbox_radius);
+    std::vector<Field> fields(count);
+    // Cranks that turn fully have no dead points, so coarse steps can not change their assembly branch
+    std::vector<bool> full_turn(count);
+    for (int i = 0; i < count; i++)
+    {
+        full_turn[i] = mechanisms[i].getLinkageType() == LinkageType::CrankRocker || mechanisms[i].getLinkageType() == LinkageType::DoubleCrank;
+        std::vector<AngleInterval> intervals = mechanisms[i].getFeasibleAngleIntervals();
+        for (int k = 0; k < 3 && !intervals.empty(); k++)
+        {
+            const AngleInterval &interval = intervals[engine() % intervals.size()];
+            FourBarMechanism posed = mechanisms[i];
+            posed.tryRotate(interval.start + (interval.end - interval.start) * std::uniform_real_distribution<>(0, 1)(engine), 0.01);
+            auto [crank_top, output_top] = posed.getCouplerHeadTopPositions();
+            fields[i].addButtonPair(ButtonPair{std::get<0>(crank_top) + offset(engine), std::get<1>(crank_top) + offset(engine), hitbox_radius,
+                                               std::get<0>(output_top) + offset(engine), std::get<1>(output_top) + offset(engine), hitbox_radius});
+        }
+    }
+    CycleOptions options;
+    options.adaptive = false;
+    options.energy_samples = 0;
+    options.angle_step = 0.001;
+    std::vector<std::uint64_t> reference(count);
+    long reference_hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        CycleResult cycle = evaluateCycle(mechanisms[i], fields[i], options);
+        reference[i] = cycle.pressed_button_pairs;
+        reference_hits += cycle.buttons_pressed;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double reference_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+    // Near a dead point a step can land on the other assembly branch, and the sweep then follows that branch. The jump
+    // to the start of the next interval can also land on either branch, depending on where the step before it ended.
+    // Such mechanisms visit different poses at different steps, so they are also counted apart
+    auto branches = [](FourBarMechanism mechanism, double angle_step)
+    {
+        // The branch each interval starts on, and every branch it changes to
+        std::vector<AssemblyBranch> sequence;
+        for (const AngleInterval &interval : mechanism.getFeasibleAngleIntervals())
+        {
+            bool has_branch = false;
+            mechanism.sweep(interval.start, interval.end, angle_step, 0.01, [&](FourBarMechanism &moved, RotationStatus status)
+                            {
+                if (status == RotationStatus::Infeasible)
+                {
+                    return;
+                }
+                if (!has_branch || moved.getAssemblyBranch() != sequence.back())
+                {
+                    sequence.push_back(moved.getAssemblyBranch());
+                }
+                has_branch = true; });
+        }
+        return sequence;
+    };
+    std::vector<std::vector<AssemblyBranch>> reference_branches(count);
+    std::vector<bool> reference_changes_branch(count);
+    for (int i = 0; i < count; i++)
+    {
+        reference_branches[i] = branches(mechanisms[i], 0.001);
+        reference_changes_branch[i] = reference_branches[i].size() > mechanisms[i].getFeasibleAngleIntervals().size();
+    }
+    std::cout << "Full turn cranks: " << std::count(full_turn.begin(), full_turn.end(), true) << "\n";
+    std::cout << "Pose test, step 0.001: " << reference_hits << " buttons pressed, " << reference_seconds << " seconds, "
+              << std::count(reference_changes_branch.begin(), reference_changes_branch.end(), true) << " mechanisms change branch within an interval\n";
+    for (double angle_step : {0.01, 0.02, 0.05})
+    {
+        for (bool swept : {false, true})
+        {
+            options.angle_step = angle_step;
+            options.swept = swept;
+            long hits = 0;
+            int missed = 0;
+            int extra = 0;
+            int full_turn_different = 0;
+            int stable_missed = 0;
+            int stable_extra = 0;
+            std::vector<bool> stable(count);
+            for (int i = 0; i < count; i++)
+            {
+                stable[i] = !reference_changes_branch[i] && branches(mechanisms[i], angle_step) == reference_branches[i];
+            }
+            start = std::chrono::steady_clock::now();
+            for (int i = 0; i < count; i++)
+            {
+                CycleResult cycle = evaluateCycle(mechanisms[i], fields[i], options);
+                hits += cycle.buttons_pressed;
+                missed += (reference[i] & ~cycle.pressed_button_pairs) != 0;
+                extra += (cycle.pressed_button_pairs & ~reference[i]) != 0;
+                full_turn_different += full_turn[i] && cycle.pressed_button_pairs != reference[i];
+                stable_missed += stable[i] && (reference[i] & ~cycle.pressed_button_pairs) != 0;
+                stable_extra += stable[i] && (cycle.pressed_button_pairs & ~reference[i]) != 0;
+            }
+            end = std::chrono::steady_clock::now();
+            double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+            std::cout << (swept ? "Swept test" : "Pose test") << ", step " << angle_step << ": " << hits << " buttons pressed, mechanisms missing a button: " << missed
+                      << ", with an extra button: " << extra << " (" << full_turn_different << " full turn cranks differ, " << stable_missed << " missing and " << stable_extra
+                      << " extra among the " << std::count(stable.begin(), stable.end(), true) << " on the same branches as the reference), " << seconds << " seconds ("
+                      << reference_seconds / seconds << "x faster)\n";
+        }
+    }
+    std::cout << "\n";
+}
+
+// How many random candidates the reach check rejects for the optimize.cpp field, and what it saves in evaluateCycle
+void benchmarkReachCheck(int count)
+{
+    std::cout << "== Reach check before evaluateCycle (" << count << " mechanisms, optimize.cpp field) ==\n";
+    double hitbox_radius = 0.0142 / 1.41421356237;
+    Field playing_field({ButtonPair{0.1143, 0.3429, hitbox_radius, 0.163322, 0.329692, hitbox_radius}, ButtonPair{0.254, 0.381, hitbox_radius, 0.3048, 0.381, hitbox_radius}, ButtonPair{0.408686, 0.315214, hitbox_radius, 0.4445, 0.2794, hitbox_radius}});
+    std::vector<FourBarMechanism> mechanisms = generateMechanisms(count, 79);
+
+    int rejected = 0;
+    int reachable_pairs = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const FourBarMechanism &mechanism : mechanisms)
+    {
+        int reachable = 0;
+        for (const ButtonPair &button_pair : playing_field.getButtonPairs())
+        {
+            reachable += mechanism.canPressButtonPair(button_pair);
+        }
+        reachable_pairs += reachable;
+        rejected += reachable == 0;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double check_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    CycleOptions options;
+    options.skip_unreachable = false;
+    std::vector<CycleResult> full(count);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        full[i] = evaluateCycle(mechanisms[i], playing_field, options);
+    }
+    end = std::chrono::steady_clock::now();
+    double full_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    options.skip_unreachable = true;
+    int different = 0;
+    int wrongly_rejected = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        CycleResult checked = evaluateCycle(mechanisms[i], playing_field, options);
+        different += checked.pressed_button_pairs != full[i].pressed_button_pairs || checked.energy_mean != full[i].energy_mean;
+        wrongly_rejected += checked.steps == 0 && full[i].buttons_pressed > 0;
+    }
+    end = std::chrono::steady_clock::now();
+    double checked_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    // Pairs a rejected mechanism would press, over every pair
+    int pressed_unreachable = 0;
+    for (int i = 0; i < count; i++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            pressed_unreachable += ((full[i].pressed_button_pairs >> k) & 1) && !mechanisms[i].canPressButtonPair(playing_field.getButtonPairs()[k]);
+        }
+    }
+    std::cout << "Rejected: " << rejected << " of " << count << " (" << 100.0 * rejected / count << "%), reachable pairs per mechanism: " << double(reachable_pairs) / count << "\n";
+    std::cout << "Check: " << check_seconds / count * 1e9 << " ns per mechanism\n";
+    std::cout << "Pressed pairs the check called unreachable: " << pressed_unreachable << ", wrongly rejected mechanisms: " << wrongly_rejected << ", different results: " << different << "\n";
+    check(pressed_unreachable == 0 && wrongly_rejected == 0 && different == 0, "the reach check rejected a mechanism that presses a pair");
+    std::cout << "evaluateCycle without the check: " << full_seconds << " seconds, with it: " << checked_seconds << " seconds, speedup " << full_seconds / checked_seconds << "x\n\n";
+}
+
+void benchmarkStaticField(int count)
+{
+    std::cout << "== StaticField against Field (" << count << " mechanisms, optimize.cpp field) ==\n";
+    double hitbox_radius = 0.0142 / 1.41421356237;
+    ButtonPair pair_1{0.1143, 0.3429, hitbox_radius, 0.163322, 0.329692, hitbox_radius};
+    ButtonPair pair_2{0.254, 0.381, hitbox_radius, 0.3048, 0.381, hitbox_radius};
+    ButtonPair pair_3{0.408686, 0.315214, hitbox_radius, 0.4445, 0.2794, hitbox_radius};
+    Field dynamic_field({pair_1, pair_2, pair_3});
+    StaticField static_field(pair_1, pair_2, pair_3);
+    std::vector<FourBarMechanism> mechanisms = generateMechanisms(count, 83);
+    ButtonPair pairs[] = {pair_1, pair_2, pair_3};
+
+    // Top point positions of every pose, so the timed loops only query the fields
+    std::vector<std::tuple<double, double>> crank_tops;
+    std::vector<std::tuple<double, double>> output_tops;
+    for (const FourBarMechanism &mechanism : mechanisms)
+    {
+        FourBarMechanism moved = mechanism;
+        moved.sweep(0, 2 * PI, 0.01, 0.01, [&](FourBarMechanism &pose, RotationStatus status)
+                    {
+                        if (status == RotationStatus::Infeasible)
+                        {
+                            return;
+                        }
+                        auto [crank_top, output_top] = pose.getCouplerHeadTopPositions();
+                        crank_tops.push_back(crank_top);
+                        output_tops.push_back(output_top);
+                    });
+    }
+    // The random poses rarely press anything, so poses around the centers of the pairs are added, inside the hitboxes
+    // and just outside them
+    std::mt19937 engine(85);
+    std::uniform_real_distribution<> offset(-1.5 * hitbox_radius, 1.5 * hitbox_radius);
+    for (int i = 0; i < count; i++)
+    {
+        for (const ButtonPair &target : pairs)
+        {
+            crank_tops.push_back({target.x1 + offset(engine), target.y1 + offset(engine)});
+            output_tops.push_back({target.x2 + offset(engine), target.y2 + offset(engine)});
+        }
+    }
+    int poses = crank_tops.size();
+
+    auto queryPoses = [&](const auto &field, std::vector<int> &indices)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < poses; i++)
+        {
+            indices[i] = field.getButtonPairPressedIndex(crank_tops[i], output_tops[i]);
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+    };
+    std::vector<int> dynamic_indices(poses);
+    std::vector<int> static_indices(poses);
+    double dynamic_query_seconds = queryPoses(dynamic_field, dynamic_indices);
+    double static_query_seconds = queryPoses(static_field, static_indices);
+    int query_mismatches = 0;
+    int hits = 0;
+    for (int i = 0; i < poses; i++)
+    {
+        query_mismatches += dynamic_indices[i] != static_indices[i];
+        hits += static_indices[i] != -1;
+    }
+
+    // Swept masks of the moves between consecutive poses, and of moves from every pose to the centers of one of the pairs,
+    // since the random poses rarely press anything
+    int swept_mismatches = 0;
+    int swept_hits = 0;
+    std::vector<std::uint64_t> dynamic_mask;
+    std::vector<std::uint64_t> static_mask;
+    for (int i = 1; i < poses; i++)
+    {
+        const ButtonPair &target = pairs[i % 3];
+        std::tuple<double, double> moves[][2] = {{crank_tops[i], output_tops[i]}, {{target.x1, target.y1}, {target.x2, target.y2}}};
+        for (auto &move : moves)
+        {
+            dynamic_field.getSweptPressedMask(crank_tops[i - 1], output_tops[i - 1], move[0], move[1], dynamic_mask);
+            static_field.getSweptPressedMask(crank_tops[i - 1], output_tops[i - 1], move[0], move[1], static_mask);
+            swept_mismatches += dynamic_mask != static_mask;
+            swept_hits += static_mask[0] != 0;
+        }
+    }
+
+    // Every mechanism is swept, the reach check would skip most of them
+    CycleOptions options;
+    options.skip_unreachable = false;
+    auto evaluate = [&](const auto &field, std::vector<CycleResult> &results)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++)
+        {
+            results[i] = evaluateCycle(mechanisms[i], field, options);
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+    };
+    std::vector<CycleResult> dynamic_results(count);
+    std::vector<CycleResult> static_results(count);
+    // Warm up once, the first pass over the mechanisms is slower whichever field goes first
+    evaluate(static_field, static_results);
+    double dynamic_cycle_seconds = evaluate(dynamic_field, dynamic_results);
+    double static_cycle_seconds = evaluate(static_field, static_results);
+    int cycle_mismatches = 0;
+    for (int i = 0; i < count; i++)
+    {
+        cycle_mismatches += dynamic_results[i].pressed_button_pairs != static_results[i].pressed_button_pairs || dynamic_results[i].steps != static_results[i].steps;
+    }
+
+    std::cout << "Pressed queries over " << poses << " poses (" << hits << " hits): Field " << dynamic_query_seconds / poses * 1e9 << " ns, StaticField " << static_query_seconds / poses * 1e9
+              << " ns, speedup " << dynamic_query_seconds / static_query_seconds << "x, mismatches: " << query_mismatches << "\n";
+    std::cout << "Swept masks over " << 2 * (poses - 1) << " moves (" << swept_hits << " hits), mismatches: " << swept_mismatches << "\n";
+    std::cout << "evaluateCycle: Field " << dynamic_cycle_seconds << " seconds, StaticField " << static_cycle_seconds << " seconds, speedup " << dynamic_cycle_seconds / static_cycle_seconds
+              << "x, mismatches: " << cycle_mismatches << "\n\n";
+    check(hits > 0 && swept_hits > 0, "no StaticField query pressed a pair, the comparison tests nothing");
+    check(query_mismatches == 0 && swept_mismatches == 0 && cycle_mismatches == 0, "StaticField differs from Field");
+}
+
+// Scoring each mechanism against several fields: one evaluateCycle per field against one cached curve per mechanism
+void benchmarkCouplerCurve(int count, int field_count)
+{
+    std::cout << "== Coupler curve cache (" << count << " mechanisms, " << field_count << " fields each, step 0.001) ==\n";
+    double hitbox_radius = 0.0142 / 1.41421356237;
+    std::vector<FourBarMechanism> mechanisms = generateMechanisms(count, 89);
+    // Three button pairs around poses of each mechanism per field, like benchmarkSweptHits
+    std::mt19937 engine(97);
+    std::uniform_real_distribution<> offset(-hitbox_radius, hitbox_radius);
+    std::vector<std::vector<Field>> fields(count, std::vector<Field>(field_count));
+    for (int i = 0; i < count; i++)
+    {
+        std::vector<AngleInterval> intervals = mechanisms[i].getFeasibleAngleIntervals();
+        for (int f = 0; f < field_count; f++)
+        {
+            for (int k = 0; k < 3 && !intervals.empty(); k++)
+            {
+                const AngleInterval &interval = intervals[engine() % intervals.size()];
+                FourBarMechanism posed = mechanisms[i];
+                posed.tryRotate(interval.start + (interval.end - interval.start) * std::uniform_real_distribution<>(0, 1)(engine), 0.01);
+                auto [crank_top, output_top] = posed.getCouplerHeadTopPositions();
+                fields[i][f].addButtonPair(ButtonPair{std::get<0>(crank_top) + offset(engine), std::get<1>(crank_top) + offset(engine), hitbox_radius,
+                                                      std::get<0>(output_top) + offset(engine), std::get<1>(output_top) + offset(engine), hitbox_radius});
+            }
+        }
+    }
+
+    CycleOptions options;
+    options.adaptive = false;
+    options.energy_samples = 0;
+    options.skip_unreachable = false;
+    options.angle_step = 0.001;
+    std::vector<std::uint64_t> reference(count * field_count);
+    long hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        for (int f = 0; f < field_count; f++)
+        {
+            CycleResult cycle = evaluateCycle(mechanisms[i], fields[i][f], options);
+            reference[i * field_count + f] = cycle.pressed_button_pairs;
+            hits += cycle.buttons_pressed;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double cycle_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+    // evaluateCycle only records the first pair pressed at a pose, the curve queries record all of them
+    std::cout << "evaluateCycle per field: " << cycle_seconds << " seconds, " << hits << " buttons pressed\n";
+
+    std::vector<std::uint64_t> mask;
+    for (int decimation : {1, 4, 16})
+    {
+        long poses = 0;
+        double sweep_seconds = 0;
+        double query_seconds = 0;
+        double pose_seconds = 0;
+        int point_missed = 0;
+        int point_extra = 0;
+        int swept_missed = 0;
+        int swept_extra = 0;
+        int static_mismatches = 0;
+        for (int i = 0; i < count; i++)
+        {
+            start = std::chrono::steady_clock::now();
+            CouplerCurve curve(mechanisms[i], options.angle_step, options.dt, decimation);
+            end = std::chrono::steady_clock::now();
+            sweep_seconds += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1e9;
+            poses += curve.size();
+            start = std::chrono::steady_clock::now();
+            for (int f = 0; f < field_count; f++)
+            {
+                std::uint64_t expected = reference[i * field_count + f];
+                fields[i][f].getCurvePressedMask(curve, mask);
+                point_missed += (expected & ~mask[0]) != 0;
+                point_extra += (mask[0] & ~expected) != 0;
+            }
+            end = std::chrono::steady_clock::now();
+            pose_seconds += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1e9;
+            start = std::chrono::steady_clock::now();
+            for (int f = 0; f < field_count; f++)
+            {
+                std::uint64_t expected = reference[i * field_count + f];
+                fields[i][f].getCurveSweptPressedMask(curve, mask);
+                swept_missed += (expected & ~mask[0]) != 0;
+                swept_extra += (mask[0] & ~expected) != 0;
+            }
+            end = std::chrono::steady_clock::now();
+            query_seconds += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1e9;
+            // The same queries of StaticField
+            for (int f = 0; f < field_count; f++)
+            {
+                const std::vector<ButtonPair> &button_pairs = fields[i][f].getButtonPairs();
+                if (button_pairs.size() != 3)
+                {
+                    continue;
+                }
+                StaticField static_field(button_pairs[0], button_pairs[1], button_pairs[2]);
+                std::vector<std::uint64_t> static_mask;
+                fields[i][f].getCurvePressedMask(curve, mask);
+                static_field.getCurvePressedMask(curve, static_mask);
+                static_mismatches += mask != static_mask;
+                fields[i][f].getCurveSweptPressedMask(curve, mask);
+                static_field.getCurveSweptPressedMask(curve, static_mask);
+                static_mismatches += mask != static_mask;
+                static_mismatches += fields[i][f].getCurveClearance(curve) != static_field.getCurveClearance(curve);
+            }
+        }
+        std::cout << "Decimation " << decimation << ": " << double(poses) / count << " poses per curve (" << double(poses) / count * 6 * sizeof(double) / 1024
+                  << " KiB with energies), sweep " << sweep_seconds << " seconds, pose queries " << pose_seconds << " seconds ("
+                  << cycle_seconds / (sweep_seconds + pose_seconds) << "x faster than evaluateCycle per field), swept queries " << query_seconds << " seconds\n";
+        std::cout << "    Pose test missing a button: " << point_missed << ", with an extra button: " << point_extra << ", swept test missing a button: " << swept_missed << ", with an extra button: " << swept_extra
+                  << " (of " << count * field_count << " scores), StaticField mismatches: " << static_mismatches << "\n";
+        check(static_mismatches == 0, "StaticField curve queries differ from Field");
+    }
+    std::cout << "\n";
+}
+
+// Runs the optimizer for many generations with a fitness that costs nothing, so what is left is the work of the optimizer
+// itself, and compares waiting for the chunks of a generation on a latch with restarting the pool for every generation
+// The limits of optimize.cpp
+GenerationLimits getOptimizeLimits()
+{
+    GenerationLimits limits;
+    limits.input_ground_point_lower_limit = std::make_tuple(0.0, 0.0);
+    limits.input_ground_point_upper_limit = std::make_tuple(0.3048, 0.3048);
+    limits.input_coupler_point_lower_limit = std::make_tuple(0.0, 0.0);
+    limits.input_coupler_point_upper_limit = std::make_tuple(0.6096, 0.6096);
+    limits.coupler_output_point_lower_limit = std::make_tuple(0.0, 0.0);
+    limits.coupler_output_point_upper_limit = std::make_tuple(0.6096, 0.6096);
+    limits.output_ground_point_lower_limit = std::make_tuple(0.0, 0.0);
+    limits.output_ground_point_upper_limit = std::make_tuple(0.3048, 0.3048);
+    limits.couplertop_input_point_lower_limit = std::make_tuple(0.0, 0.0);
+    limits.couplertop_input_point_upper_limit = std::make_tuple(0.6096, 0.6096);
+    limits.couplertop_output_point_lower_limit = std::make_tuple(0.0, 0.0);
+    limits.couplertop_output_point_upper_limit = std::make_tuple(0.6096, 0.6096);
+    return limits;
+}
+
+void benchmarkOptimizerGenerations(int generations)
+{
+    std::cout << "== Optimizer over " << generations << " generations (100 mechanisms, chunks of 10, 4 threads) ==\n";
+    GenerationLimits limits = getOptimizeLimits();
+
+    std::atomic<long> evaluations(0);
+    auto fitness = [&](const FourBarMechanism &mechanism)
+    {
+        evaluations++;
+        return std::get<0>(std::get<1>(mechanism.getInputLinkPositions()));
+    };
+    Optimizer optimizer(100, 10, 4, fitness, limits);
+    optimizer.setVerbose(false);
+    auto start = std::chrono::steady_clock::now();
+    optimizer.optimize(generations);
+    auto end = std::chrono::steady_clock::now();
+    double optimize_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+    // optimize evaluates every generation and the last children once more
+    long expected = 100L * (generations + 1);
+    std::cout << "Evaluations: " << evaluations << " of " << expected << (evaluations == expected ? " (all generations completed)" : " (MISSING EVALUATIONS)") << "\n";
+    check(evaluations == expected, "the optimizer skipped evaluations");
+    std::cout << "Per generation: " << optimize_seconds / generations * 1e6 << " us\n";
+
+    // 10 empty chunks per generation, so only handing them to the workers and waiting for them is timed
+    auto empty_chunk = [](int id) {};
+    WorkStealingPool stealing_pool(4, 10);
+    start = std::chrono::steady_clock::now();
+    for (int generation = 0; generation < generations; generation++)
+    {
+        stealing_pool.parallelFor(100, [](int begin, int end) {});
+    }
+    end = std::chrono::steady_clock::now();
+    double stealing_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    // The ctpl pool kept alive, waiting on the future of every chunk
+    ctpl::thread_pool pool(4);
+    std::vector<std::future<void>> futures;
+    start = std::chrono::steady_clock::now();
+    for (int generation = 0; generation < generations; generation++)
+    {
+        futures.clear();
+        for (int chunk = 0; chunk < 10; chunk++)
+        {
+            futures.push_back(pool.push(empty_chunk));
+        }
+        for (std::future<void> &future : futures)
+        {
+            future.get();
+        }
+    }
+    end = std::chrono::steady_clock::now();
+    double futures_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    // What stopping the pool to wait costs when it is restarted for the next generation
+    start = std::chrono::steady_clock::now();
+    for (int generation = 0; generation < generations; generation++)
+    {
+        ctpl::thread_pool restarted_pool(4);
+        for (int chunk = 0; chunk < 10; chunk++)
+        {
+            restarted_pool.push(empty_chunk);
+        }
+        restarted_pool.stop(true);
+    }
+    end = std::chrono::steady_clock::now();
+    double restart_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+    std::cout << "Dispatch and wait for 100 empty items: work stealing pool " << stealing_seconds / generations * 1e6 << " us, persistent ctpl pool with 10 futures "
+              << futures_seconds / generations * 1e6 << " us, restarting the ctpl pool " << restart_seconds / generations * 1e6 << " us per generation\n\n";
+}
+
+// One generation of the optimize.cpp fitness over random candidates, most of which are rejected early by the reach check
+// while the others sweep a full cycle. Fixed chunks on the ctpl pool against the work stealing pool, from 1 to 64 threads
+void benchmarkWorkStealing(int count, int generations)
+{
+    std::cout << "== Work stealing against fixed chunks (" << count << " mechanisms, " << generations << " generations, " << std::thread::hardware_concurrency() << " hardware threads) ==\n";
+    double hitbox_radius = 0.0142 / 1.41421356237;
+    StaticField playing_field(ButtonPair{0.1143, 0.3429, hitbox_radius, 0.163322, 0.329692, hitbox_radius}, ButtonPair{0.254, 0.381, hitbox_radius, 0.3048, 0.381, hitbox_radius}, ButtonPair{0.408686, 0.315214, hitbox_radius, 0.4445, 0.2794, hitbox_radius});
+    std::vector<FourBarMechanism> mechanisms = generateMechanisms(count, 101);
+    auto fitness = [&](const FourBarMechanism &mechanism)
+    {
+        CycleResult cycle = evaluateCycle(mechanism, playing_field);
+        return cycle.energy_deviation - cycle.energy_samples * 1000 + (3 - cycle.buttons_pressed) * 1000;
+    };
+    std::vector<double> reference(count);
+    for (int i = 0; i < count; i++)
+    {
+        reference[i] = fitness(mechanisms[i]);
+    }
+
+    double fixed_single = 0;
+    double stealing_single = 0;
+    for (int threads : {1, 2, 4, 8, 16, 32, 64})
+    {
+        std::vector<double> fitnesses(count);
+        ctpl::thread_pool pool(threads);
+        std::vector<std::future<void>> futures;
+        auto start = std::chrono::steady_clock::now();
+        for (int generation = 0; generation < generations; generation++)
+        {
+            futures.clear();
+            for (int begin = 0; begin < count; begin += 10)
+            {
+                int end = std::min(begin + 10, count);
+                futures.push_back(pool.push([&, begin, end](int id)
+                                            {
+                    for (int i = begin; i < end; i++)
+                    {
+                        fitnesses[i] = fitness(mechanisms[i]);
+                    } }));
+            }
+            for (std::future<void> &future : futures)
+            {
+                future.get();
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        double fixed_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0 / generations;
+        int fixed_mismatches = 0;
+        for (int i = 0; i < count; i++)
+        {
+            fixed_mismatches += fitnesses[i] != reference[i];
+        }
+
+        std::fill(fitnesses.begin(), fitnesses.end(), 0);
+        WorkStealingPool stealing_pool(threads, 10);
+        long stolen = 0;
+        start = std::chrono::steady_clock::now();
+        for (int generation = 0; generation < generations; generation++)
+        {
+            stealing_pool.parallelFor(count, [&](int begin, int end)
+                                      {
+                for (int i = begin; i < end; i++)
+                {
+                    fitnesses[i] = fitness(mechanisms[i]);
+                } });
+            stolen += stealing_pool.getStolenCount();
+        }
+        end = std::chrono::steady_clock::now();
+        double stealing_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0 / generations;
+        int stealing_mismatches = 0;
+        for (int i = 0; i < count; i++)
+        {
+            stealing_mismatches += fitnesses[i] != reference[i];
+        }
+
+        if (threads == 1)
+        {
+            fixed_single = fixed_seconds;
+            stealing_single = stealing_seconds;
+        }
+        std::cout << threads << " threads: fixed chunks " << fixed_seconds * 1000 << " ms (speedup " << fixed_single / fixed_seconds << "x), work stealing "
+                  << stealing_seconds * 1000 << " ms (speedup " << stealing_single / stealing_seconds << "x, " << double(stolen) / generations
+                  << " mechanisms stolen per generation), mismatches: " << fixed_mismatches + stealing_mismatches << "\n";
+        check(fixed_mismatches + stealing_mismatches == 0, "parallel fitnesses differ from the sequential ones");
+    }
+    std::cout << "\n";
+}
+
+// The evaluation path before and after reading the mechanisms in place and writing the fitnesses into a preallocated vector
+// The copying path copies every chunk into a vector, passes each mechanism by value, pairs it with its fitness in a tuple
+// and concatenates the chunks, as the evaluation of Optimizer used to
+void benchmarkZeroCopyEvaluation(int count, int generations)
+{
+    std::cout << "== Zero copy evaluation (" << count << " mechanisms of " << sizeof(FourBarMechanism) << " bytes, " << generations << " generations, 4 threads) ==\n";
+    double hitbox_radius = 0.0142 / 1.41421356237;
+    StaticField playing_field(ButtonPair{0.1143, 0.3429, hitbox_radius, 0.163322, 0.329692, hitbox_radius}, ButtonPair{0.254, 0.381, hitbox_radius, 0.3048, 0.381, hitbox_radius}, ButtonPair{0.408686, 0.315214, hitbox_radius, 0.4445, 0.2794, hitbox_radius});
+    std::vector<FourBarMechanism> mechanisms = generateMechanisms(count, 103);
+    // The reach check alone, so the copies are a visible part of the cost, and the full optimize.cpp fitness
+    auto reach_fitness = [&](const FourBarMechanism &mechanism)
+    {
+        double reachable = 0;
+        for (const ButtonPair &button_pair : playing_field.getButtonPairs())
+        {
+            reachable += mechanism.canPressButtonPair(button_pair);
+        }
+        return reachable;
+    };
+    auto cycle_fitness = [&](const FourBarMechanism &mechanism)
+    {
+        CycleResult cycle = evaluateCycle(mechanism, playing_field);
+        return cycle.energy_deviation - cycle.energy_samples * 1000 + (3 - cycle.buttons_pressed) * 1000;
+    };
+    WorkStealingPool pool(4, 10);
+    for (int variant = 0; variant < 2; variant++)
+    {
+        std::function<double(FourBarMechanism)> by_value;
+        std::function<double(const FourBarMechanism &)> by_reference;
+        if (variant == 0)
+        {
+            by_value = reach_fitness;
+            by_reference = reach_fitness;
+        }
+        else
+        {
+            by_value = cycle_fitness;
+            by_reference = cycle_fitness;
+        }
+
+        int num_chunks = (count + 9) / 10;
+        std::vector<std::tuple<FourBarMechanism, double>> evaluated_mechanisms;
+        long copying_allocations = allocation_count;
+        auto start = std::chrono::steady_clock::now();
+        for (int generation = 0; generation < generations; generation++)
+        {
+            std::vector<std::vector<std::tuple<FourBarMechanism, double>>> chunk_results(num_chunks);
+            pool.parallelFor(num_chunks, [&](int begin, int end)
+                             {
+                for (int chunk = begin; chunk < end; chunk++)
+                {
+                    std::vector<FourBarMechanism> copied(mechanisms.begin() + chunk * 10, mechanisms.begin() + std::min(chunk * 10 + 10, count));
+                    for (const FourBarMechanism &mechanism : copied)
+                    {
+                        chunk_results[chunk].push_back(std::make_tuple(mechanism, by_value(mechanism)));
+                    }
+                } });
+            evaluated_mechanisms.clear();
+            for (const std::vector<std::tuple<FourBarMechanism, double>> &chunk_result : chunk_results)
+            {
+                evaluated_mechanisms.insert(evaluated_mechanisms.end(), chunk_result.begin(), chunk_result.end());
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        double copying_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0 / generations;
+        copying_allocations = (allocation_count - copying_allocations) / generations;
+
+        std::vector<double> fitnesses;
+        fitnesses.reserve(count);
+        long in_place_allocations = allocation_count;
+        start = std::chrono::steady_clock::now();
+        for (int generation = 0; generation < generations; generation++)
+        {
+            fitnesses.resize(count);
+            pool.parallelFor(count, [&](int begin, int end)
+                             {
+                for (int i = begin; i < end; i++)
+                {
+                    fitnesses[i] = by_reference(mechanisms[i]);
+                } });
+        }
+        end = std::chrono::steady_clock::now();
+        double in_place_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0 / generations;
+        in_place_allocations = (allocation_count - in_place_allocations) / generations;
+
+        int mismatches = 0;
+        for (int i = 0; i < count; i++)
+        {
+            mismatches += std::get<1>(evaluated_mechanisms[i]) != fitnesses[i];
+        }
+        std::cout << (variant == 0 ? "Reach check fitness" : "evaluateCycle fitness") << ": copying " << copying_seconds * 1000 << " ms and " << copying_allocations
+                  << " allocations per generation, in place " << in_place_seconds * 1000 << " ms and " << in_place_allocations << " allocations per generation ("
+                  << copying_seconds / in_place_seconds << "x faster), mismatches: " << mismatches << "\n";
+        check(mismatches == 0 && in_place_allocations == 0, "in place evaluation differs from copying or allocates");
+    }
+    std::cout << "\n";
+}
+
+// Every point of every mechanism, to compare runs bit for bit
+std::vector<double> getGenerationPoints(const std::vector<FourBarMechanism> &mechanisms)
+{
+    std::vector<double> points;
+    for (const FourBarMechanism &mechanism : mechanisms)
+    {
+        for (auto [first, second] : {mechanism.getInputLinkPositions(), mechanism.getOutputLinkPositions(), mechanism.getCouplerHeadTopPositions()})
+        {
+            points.insert(points.end(), {std::get<0>(first), std::get<1>(first), std::get<0>(second), std::get<1>(second)});
+        }
+    }
+    return points;
+}
+
+// The same seed with different numbers of threads has to give the same hall of fame, a different seed a different one
+void benchmarkReproducibleOptimizer(int generations)
+{
+    std::cout << "== Reproducible optimizer runs (" << generations << " generations of 200 mechanisms, optimize.cpp fitness) ==\n";
+    double hitbox_radius = 0.0142 / 1.41421356237;
+    StaticField playing_field(ButtonPair{0.1143, 0.3429, hitbox_radius, 0.163322, 0.329692, hitbox_radius}, ButtonPair{0.254, 0.381, hitbox_radius, 0.3048, 0.381, hitbox_radius}, ButtonPair{0.408686, 0.315214, hitbox_radius, 0.4445, 0.2794, hitbox_radius});
+    auto fitness = [&](const FourBarMechanism &mechanism)
+    {
+        CycleResult cycle = evaluateCycle(mechanism, playing_field);
+        return cycle.energy_deviation - cycle.energy_samples * 1000 + (3 - cycle.buttons_pressed) * 1000;
+    };
+    auto run = [&](std::uint64_t seed, int threads)
+    {
+        Optimizer optimizer(200, 10, threads, fitness, getOptimizeLimits());
+        optimizer.setVerbose(false);
+        optimizer.setSeed(seed);
+        optimizer.optimize(generations);
+        return getGenerationPoints(optimizer.getBestMechanisms(10));
+    };
+    std::vector<double> reference = run(42, 1);
+    for (int threads : {2, 4, 16})
+    {
+        bool identical = run(42, threads) == reference;
+        std::cout << "Seed 42 with " << threads << " threads: " << (identical ? "identical" : "DIFFERENT") << " to 1 thread\n";
+        check(identical, "the optimizer depends on the number of threads");
+    }
+    bool other_seed_identical = run(43, 1) == reference;
+    std::cout << "Seed 43 with 1 thread: " << (other_seed_identical ? "IDENTICAL" : "different") << " to seed 42\n\n";
+    check(!other_seed_identical, "the optimizer ignores its seed");
+}
+
+// Mechanisms per second in the two phases of a generation, creating the children and evaluating them, with a fitness that
+// only runs the reach check, so creating the children is not hidden behind a long simulation
+void benchmarkOffspringGeneration(int generations)
+{
+    std::cout << "== Offspring generation and evaluation throughput (" << generations << " generations, reach check fitness) ==\n";
+    double hitbox_radius = 0.0142 / 1.41421356237;
+    StaticField playing_field(ButtonPair{0.1143, 0.3429, hitbox_radius, 0.163322, 0.329692, hitbox_radius}, ButtonPair{0.254, 0.381, hitbox_radius, 0.3048, 0.381, hitbox_radius}, ButtonPair{0.408686, 0.315214, hitbox_radius, 0.4445, 0.2794, hitbox_radius});
+    auto fitness = [&](const FourBarMechanism &mechanism)
+    {
+        double unreachable = 0;
+        for (const ButtonPair &button_pair : playing_field.getButtonPairs())
+        {
+            unreachable += !mechanism.canPressButtonPair(button_pair);
+        }
+        return unreachable;
+    };
+    for (int population : {10000, 100000})
+    {
+        for (int threads : {1, 4})
+        {
+            Optimizer optimizer(population, 10, threads, fitness, getOptimizeLimits());
+            optimizer.setVerbose(false);
+            optimizer.setSeed(7);
+            optimizer.optimize(generations);
+            std::cout << population << " mechanisms, " << threads << " threads: children " << optimizer.getGenerationThroughput() / 1e6 << " M/s, evaluation "
+                      << optimizer.getEvaluationThroughput() / 1e6 << " M/s\n";
+        }
+    }
+    std::cout << "\n";
+}
+
+// The generations are arenas of flat 12 double genomes, a mechanism is only built on the stack of the worker evaluating it
+// Checks that optimize does not allocate once the optimizer is constructed, and how many bytes a generation moves
+void benchmarkGenomeArena(int generations)
+{
+    std::cout << "== Genome arenas (" << generations << " generations, reach check fitness, 4 threads) ==\n";
+    double hitbox_radius = 0.0142 / 1.41421356237;
+    StaticField playing_field(ButtonPair{0.1143, 0.3429, hitbox_radius, 0.163322, 0.329692, hitbox_radius}, ButtonPair{0.254, 0.381, hitbox_radius, 0.3048, 0.381, hitbox_radius}, ButtonPair{0.408686, 0.315214, hitbox_radius, 0.4445, 0.2794, hitbox_radius});
+    auto fitness = [&](const FourBarMechanism &mechanism)
+    {
+        double unreachable = 0;
+        for (const ButtonPair &button_pair : playing_field.getButtonPairs())
+        {
+            unreachable += !mechanism.canPressButtonPair(button_pair);
+        }
+        return unreachable;
+    };
+    std::cout << "Bytes per mechanism: genome " << sizeof(Genome) << ", FourBarMechanism " << sizeof(FourBarMechanism) << " ("
+              << double(sizeof(FourBarMechanism)) / sizeof(Genome) << "x less per generation buffer)\n";
+    for (int population : {1000, 100000})
+    {
+        Optimizer optimizer(population, 10, 4, fitness, getOptimizeLimits());
+        optimizer.setVerbose(false);
+        optimizer.setSeed(11);
+        long allocations = allocation_count;
+        auto start = std::chrono::steady_clock::now();
+        optimizer.optimize(generations);
+        auto end = std::chrono::steady_clock::now();
+        allocations = allocation_count - allocations;
+        double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0 / generations;
+        std::cout << population << " mechanisms: " << seconds * 1000 << " ms per generation, " << allocations << " allocations in optimize, children "
+                  << optimizer.getGenerationThroughput() / 1e6 << " M/s, evaluation " << optimizer.getEvaluationThroughput() / 1e6 << " M/s\n";
+        check(allocations == 0, "optimize allocates once the genome arenas are built");
+    }
+    std::cout << "\n";
+}
+
+// Selection by sorting a copy of the fitnesses and keeping every fitness up to sorted[survivors], as Optimizer used to,
+// against partitioning the indices with nth_element. Fitnesses like the ones of optimize.cpp, multiples of 1000 for
+// the unpressed buttons with small energy terms, and the same fitnesses with the energy terms rounded away, so most tie
+void benchmarkTopKSelection(int count, int repetitions)
+{
+    std::cout << "== Top k selection (" << count << " fitnesses, 10% survivors, " << repetitions << " repetitions) ==\n";
+    std::mt19937 generator(5);
+    std::uniform_int_distribution<int> unpressed(0, 3);
+    std::uniform_real_distribution<double> energy(0, 1);
+    int survivors = count / 10;
+    for (bool tied : {false, true})
+    {
+        std::vector<double> fitnesses(count);
+        for (double &fitness : fitnesses)
+        {
+            fitness = unpressed(generator) * 1000 + (tied ? 0 : energy(generator));
+        }
+
+        std::vector<int> sorted_selection;
+        auto start = std::chrono::steady_clock::now();
+        for (int repetition = 0; repetition < repetitions; repetition++)
+        {
+            std::vector<double> sorted_fitnesses = fitnesses;
+            std::sort(sorted_fitnesses.begin(), sorted_fitnesses.end());
+            double threshold = sorted_fitnesses[survivors];
+            sorted_selection.clear();
+            for (int i = 0; i < count; i++)
+            {
+                if (fitnesses[i] <= threshold)
+                {
+                    sorted_selection.push_back(i);
+                }
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        double sort_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0 / repetitions;
+
+        std::vector<int> partitioned_selection;
+        partitioned_selection.reserve(count);
+        start = std::chrono::steady_clock::now();
+        for (int repetition = 0; repetition < repetitions; repetition++)
+        {
+            partitioned_selection.resize(count);
+            for (int i = 0; i < count; i++)
+            {
+                partitioned_selection[i] = i;
+            }
+            std::nth_element(partitioned_selection.begin(), partitioned_selection.begin() + survivors - 1, partitioned_selection.end(), [&](int a, int b)
+                             { return Optimizer::ranksBefore(fitnesses, a, b); });
+            partitioned_selection.resize(survivors);
+        }
+        end = std::chrono::steady_clock::now();
+        double partition_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0 / repetitions;
+
+        // Both have to keep the best fitnesses, the partition exactly the quota
+        double worst_kept = 0;
+        for (int index : partitioned_selection)
+        {
+            worst_kept = std::max(worst_kept, fitnesses[index]);
+        }
+        int better_left_out = 0;
+        for (int i = 0; i < count; i++)
+        {
+            better_left_out += fitnesses[i] < worst_kept && std::find(partitioned_selection.begin(), partitioned_selection.end(), i) == partitioned_selection.end();
+        }
+        std::cout << (tied ? "Tied fitnesses" : "Distinct fitnesses") << ": sort " << sort_seconds * 1000 << " ms keeping " << sorted_selection.size()
+                  << ", nth_element " << partition_seconds * 1000 << " ms keeping " << partitioned_selection.size() << " (" << sort_seconds / partition_seconds
+                  << "x faster), better fitnesses left out: " << better_left_out << "\n";
+        check(better_left_out == 0, "the selection left out a better fitness");
+    }
+
+    // A fitness function can return NaN. Without an order for it nth_element could keep it over numbers, ranked as
+    // infinity it is only kept when there are too few finite fitnesses. Every 7th fitness is NaN, some others are infinite
+    std::vector<double> fitnesses(count);
+    for (int i = 0; i < count; i++)
+    {
+        fitnesses[i] = i % 7 == 0 ? std::numeric_limits<double>::quiet_NaN() : i % 11 == 0 ? std::numeric_limits<double>::infinity() : unpressed(generator) * 1000 + energy(generator);
+    }
+    for (int kept : {survivors, count - count / 10})
+    {
+        std::vector<int> partitioned_selection(count);
+        std::iota(partitioned_selection.begin(), partitioned_selection.end(), 0);
+        std::nth_element(partitioned_selection.begin(), partitioned_selection.begin() + kept - 1, partitioned_selection.end(), [&](int a, int b)
+                         { return Optimizer::ranksBefore(fitnesses, a, b); });
+        partitioned_selection.resize(kept);
+        std::sort(partitioned_selection.begin(), partitioned_selection.end());
+        // The selection has to be the first kept indices of a stable sort of the fitnesses with NaN replaced by infinity
+        std::vector<double> replaced = fitnesses;
+        std::replace_if(replaced.begin(), replaced.end(), [](double fitness)
+                        { return std::isnan(fitness); }, std::numeric_limits<double>::infinity());
+        std::vector<int> sorted_selection(count);
+        std::iota(sorted_selection.begin(), sorted_selection.end(), 0);
+        std::stable_sort(sorted_selection.begin(), sorted_selection.end(), [&](int a, int b)
+                         { return replaced[a] < replaced[b]; });
+        sorted_selection.resize(kept);
+        std::sort(sorted_selection.begin(), sorted_selection.end());
+        int nan_kept = std::count_if(partitioned_selection.begin(), partitioned_selection.end(), [&](int index)
+                                     { return std::isnan(fitnesses[index]); });
+        std::cout << "With NaN fitnesses, keeping " << kept << ": " << nan_kept << " NaN kept, selection " << (partitioned_selection == sorted_selection ? "identical" : "DIFFERENT")
+                  << " to a sort with NaN as infinity\n";
+        check(partitioned_selection == sorted_selection, "the selection with NaN fitnesses is not the best ones");
+    }
+
+    // The best mechanism used to cost an evaluation of the whole last selection, the hall of fame keeps its fitness
+    double hitbox_radius = 0.0142 / 1.41421356237;
+    StaticField playing_field(ButtonPair{0.1143, 0.3429, hitbox_radius, 0.163322, 0.329692, hitbox_radius}, ButtonPair{0.254, 0.381, hitbox_radius, 0.3048, 0.381, hitbox_radius}, ButtonPair{0.408686, 0.315214, hitbox_radius, 0.4445, 0.2794, hitbox_radius});
+    auto fitness = [&](const FourBarMechanism &mechanism)
+    {
+        CycleResult cycle = evaluateCycle(mechanism, playing_field);
+        return cycle.energy_deviation - cycle.energy_samples * 1000 + (3 - cycle.buttons_pressed) * 1000;
+    };
+    Optimizer optimizer(1000, 10, 1, fitness, getOptimizeLimits());
+    optimizer.setVerbose(false);
+    optimizer.setSeed(3);
+    optimizer.optimize(5);
+    std::vector<FourBarMechanism> best_mechanisms = optimizer.getBestMechanisms(5);
+    auto start = std::chrono::steady_clock::now();
+    FourBarMechanism best_mechanism = optimizer.getBestMechanism();
+    auto end = std::chrono::steady_clock::now();
+    double query_seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1e9;
+    // What getBestMechanism used to cost, evaluating the 100 survivors of the last generation again
+    std::vector<double> best_fitnesses;
+    start = std::chrono::steady_clock::now();
+    for (const FourBarMechanism &mechanism : best_mechanisms)
+    {
+        best_fitnesses.push_back(fitness(mechanism));
+    }
+    end = std::chrono::steady_clock::now();
+    double evaluation_seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1e9 / best_mechanisms.size() * 100;
+    bool sorted = std::is_sorted(best_fitnesses.begin(), best_fitnesses.end());
+
+    // Before optimize, and after it when every fitness was infinite, there is no best mechanism to give
+    auto throwsWhenEmpty = [](Optimizer &empty_optimizer)
+    {
+        int throws = 0;
+        try
+        {
+            empty_optimizer.getBestMechanism();
+        }
+        catch (const HallOfFameIsEmpty &)
+        {
+            throws++;
+        }
+        try
+        {
+            empty_optimizer.getBestFitness();
+        }
+        catch (const HallOfFameIsEmpty &)
+        {
+            throws++;
+        }
+        return throws == 2;
+    };
+    Optimizer unused_optimizer(100, 10, 1, fitness, getOptimizeLimits());
+    unused_optimizer.setVerbose(false);
+    Optimizer rejecting_optimizer(100, 10, 1, [](const FourBarMechanism &mechanism)
+                                  { return std::numeric_limits<double>::infinity(); }, getOptimizeLimits());
+    rejecting_optimizer.setVerbose(false);
+    rejecting_optimizer.optimize(2);
+    bool empty_throws = throwsWhenEmpty(unused_optimizer) && throwsWhenEmpty(rejecting_optimizer);
+
+    std::cout << "getBestMechanism: " << query_seconds * 1e6 << " us, against " << evaluation_seconds * 1e6 << " us to evaluate 100 survivors again, stored fitness "
+              << optimizer.getBestFitness() << ", evaluated again " << fitness(best_mechanism) << ", best 5 " << (sorted ? "sorted" : "NOT SORTED")
+              << ", empty hall of fame " << (empty_throws ? "throws" : "DOES NOT THROW") << "\n\n";
+    check(optimizer.getBestFitness() == fitness(best_mechanism) && sorted, "the hall of fame does not match its mechanisms");
+    check(empty_throws, "an empty hall of fame does not throw");
+}
+
+// Runs of the optimize.cpp fitness with and without the fitness cache, at decreasing mutation rates
+// With elitism the survivors are copied into the next generation unchanged, and the cache saves evaluating them again
+// The cache only skips work, so the runs with and without it have to end with the same hall of fame
+void benchmarkFitnessCache(int generations)
+{
+    std::cout << "== Fitness cache (" << generations << " generations of 200 mechanisms with elitism, optimize.cpp fitness) ==\n";
+    // The least recently used genome is the one evicted
+    FitnessCache small_cache(2);
+    Genome first{}, second{}, third{};
+    second[0] = 1;
+    third[0] = 2;
+    double fitness = 0;
+    small_cache.insert(first, 1);
+    small_cache.insert(second, 2);
+    small_cache.find(first, fitness);
+    small_cache.insert(third, 3);
+    bool lru_correct = small_cache.find(first, fitness) && fitness == 1 && !small_cache.find(second, fitness) && small_cache.find(third, fitness) && fitness == 3;
+    std::cout << "Eviction order: " << (lru_correct ? "least recently used" : "WRONG") << "\n";
+    check(lru_correct, "the fitness cache did not evict the least recently used genome");
+    // The cost of a miss, a lookup and an insert, with a full cache that evicts on every insert
+    FitnessCache cache(10000);
+    std::mt19937 generator(9);
+    std::uniform_real_distribution<double> coordinate(0, 0.6);
+    std::vector<Genome> genomes(50000);
+    for (Genome &genome : genomes)
+    {
+        for (double &value : genome)
+        {
+            value = coordinate(generator);
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (const Genome &genome : genomes)
+    {
+        if (!cache.find(genome, fitness))
+        {
+            cache.insert(genome, genome[0]);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Miss and insert: " << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / double(genomes.size()) << " ns per genome, "
+              << cache.size() << " of " << cache.getCapacity() << " genomes kept\n";
+
+    double hitbox_radius = 0.0142 / 1.41421356237;
+    StaticField playing_field(ButtonPair{0.1143, 0.3429, hitbox_radius, 0.163322, 0.329692, hitbox_radius}, ButtonPair{0.254, 0.381, hitbox_radius, 0.3048, 0.381, hitbox_radius}, ButtonPair{0.408686, 0.315214, hitbox_radius, 0.4445, 0.2794, hitbox_radius});
+    auto fitness_function = [&](const FourBarMechanism &mechanism)
+    {
+        CycleResult cycle = evaluateCycle(mechanism, playing_field);
+        return cycle.energy_deviation - cycle.energy_samples * 1000 + (3 - cycle.buttons_pressed) * 1000;
+    };
+    for (double mutation_rate : {1.0, 0.01, 0.0001, 0.0})
+    {
+        double uncached_seconds = 0;
+        std::vector<double> uncached_points;
+        for (int cached = 0; cached < 2; cached++)
+        {
+            Optimizer optimizer(200, 10, 4, fitness_function, getOptimizeLimits());
+            optimizer.setVerbose(false);
+            optimizer.setSeed(17);
+            optimizer.setMutationRate(mutation_rate);
+            optimizer.setElitism(true);
+            if (cached)
+            {
+                optimizer.setFitnessCache(10000);
+            }
+            auto start = std::chrono::steady_clock::now();
+            optimizer.optimize(generations);
+            auto end = std::chrono::steady_clock::now();
+            double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+            std::vector<double> points = getGenerationPoints(optimizer.getBestMechanisms(10));
+            if (!cached)
+            {
+                uncached_seconds = seconds;
+                uncached_points = points;
+                continue;
+            }
+            long lookups = optimizer.getCacheHitCount() + optimizer.getCacheMissCount();
+            std::cout << "Mutation rate " << mutation_rate << ": uncached " << uncached_seconds * 1000 << " ms, cached " << seconds * 1000 << " ms ("
+                      << uncached_seconds / seconds << "x faster), " << optimizer.getCacheHitCount() << " hits in " << lookups << " evaluations ("
+                      << 100.0 * optimizer.getCacheHitCount() / lookups << "%), hall of fame " << (points == uncached_points ? "identical" : "DIFFERENT") << "\n";
+            check(points == uncached_points, "the fitness cache changed the hall of fame");
+        }
+    }
+    std::cout << "\n";
+}
+
+// The optimize.cpp fitness with and without the cutoff the Optimizer passes to it. Both have to give the same fitness
+// unless the mechanism is rejected, and a rejected mechanism has to have a full fitness above the cutoff
+void benchmarkEarlyTermination(int count, int generations)
+{
+    std::cout << "== Early termination at the cutoff (" << count << " mechanisms, optimize.cpp fitness) ==\n";
+    double hitbox_radius = 0.0142 / 1.41421356237;
+    StaticField playing_field(ButtonPair{0.1143, 0.3429, hitbox_radius, 0.163322, 0.329692, hitbox_radius}, ButtonPair{0.254, 0.381, hitbox_radius, 0.3048, 0.381, hitbox_radius}, ButtonPair{0.408686, 0.315214, hitbox_radius, 0.4445, 0.2794, hitbox_radius});
+    auto fitness = [&](const FourBarMechanism &mechanism)
+    {
+        CycleResult cycle = evaluateCycle(mechanism, playing_field);
+        return cycle.energy_deviation - cycle.energy_samples * 1000 + (3 - cycle.buttons_pressed) * 1000;
+    };
+    auto bounded_fitness = [&](const FourBarMechanism &mechanism, double cutoff)
+    {
+        CycleOptions options;
+        if (std::isfinite(cutoff))
+        {
+            options.min_buttons_pressed = (int)std::ceil(3 - options.energy_samples - cutoff / 1000);
+        }
+        CycleResult cycle = evaluateCycle(mechanism, playing_field, options);
+        if (cycle.aborted)
+        {
+            return std::numeric_limits<double>::infinity();
+        }
+        return cycle.energy_deviation - cycle.energy_samples * 1000 + (3 - cycle.buttons_pressed) * 1000;
+    };
+
+    std::vector<FourBarMechanism> mechanisms = generateMechanisms(count, 211);
+    std::vector<double> fitnesses(count);
+    // Warms up before the timed pass
+    for (int i = 0; i < count; i++)
+    {
+        fitnesses[i] = fitness(mechanisms[i]);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        fitnesses[i] = fitness(mechanisms[i]);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double full_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+    for (double cutoff : {1500.0, 500.0, -500.0, -1500.0})
+    {
+        int rejected = 0;
+        int wrong = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++)
+        {
+            double bounded = bounded_fitness(mechanisms[i], cutoff);
+            rejected += std::isinf(bounded);
+            wrong += std::isinf(bounded) ? fitnesses[i] <= cutoff : bounded != fitnesses[i];
+        }
+        end = std::chrono::steady_clock::now();
+        double bounded_seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+        std::cout << "Cutoff " << cutoff << ": " << rejected << " of " << count << " rejected, " << full_seconds / bounded_seconds << "x faster, wrong: " << wrong << "\n";
+        check(wrong == 0, "the cutoff rejected a mechanism that could beat it");
+    }
+
+    for (int bounded = 0; bounded < 2; bounded++)
+    {
+        std::vector<double> reference;
+        for (int threads : {1, 4})
+        {
+            std::unique_ptr<Optimizer> optimizer = bounded ? std::make_unique<Optimizer>(500, 10, threads, bounded_fitness, getOptimizeLimits())
+                                                           : std::make_unique<Optimizer>(500, 10, threads, fitness, getOptimizeLimits());
+            optimizer->setVerbose(false);
+            optimizer->setSeed(23);
+            optimizer->setMutationRate(0.05);
+            start = std::chrono::steady_clock::now();
+            optimizer->optimize(generations);
+            end = std::chrono::steady_clock::now();
+            double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+            if (threads == 1)
+            {
+                reference = getGenerationPoints(optimizer->getBestMechanisms(10));
+                std::cout << (bounded ? "Optimizer with cutoff: " : "Optimizer without cutoff: ") << seconds * 1000 << " ms for " << generations << " generations of 500, "
+                          << optimizer->getRejectedCount() << " rejected, best fitness " << optimizer->getBestFitness();
+            }
+            else
+            {
+                bool identical = getGenerationPoints(optimizer->getBestMechanisms(10)) == reference;
+                std::cout << ", 4 threads " << (identical ? "identical" : "DIFFERENT") << "\n";
+                check(identical, "the optimizer with a cutoff depends on the number of threads");
+            }
+        }
+    }
+    std::cout << "\n";
+}
+
+int main()
+{
+    benchmarkBatch(4096, 0.01);
+    benchmarkTryRotate(256, 0.001);
+    benchmarkSweep(256, 0.001);
+    benchmarkAdaptiveSweep(512, 0.001, 0.0142 / 1.41421356237);
+    benchmarkEnergy(256, 0.1);
+    benchmarkLazyEnergy(256, 0.001);
+    benchmarkFloatFitness(2000);
+    benchmarkBothBranches(1000, 0.001);
+    benchmarkEvaluateCycle(2000);
+    benchmarkFieldIndex(200000);
+    benchmarkPressedMask(200000);
+    benchmarkSweptHits(2000);
+    benchmarkReachCheck(20000);
+    benchmarkStaticField(2000);
+    benchmarkCouplerCurve(500, 8);
+    benchmarkOptimizerGenerations(1000);
+    benchmarkWorkStealing(2000, 5);
+    benchmarkZeroCopyEvaluation(2000, 20);
+    benchmarkReproducibleOptimizer(20);
+    benchmarkOffspringGeneration(5);
+    benchmarkGenomeArena(5);
+    benchmarkTopKSelection(100000, 20);
+    benchmarkFitnessCache(50);
+    benchmarkEarlyTermination(2000, 30);
+
+    if (failed_checks > 0)
+    {
+        std::cout << failed_checks << " correctness checks failed\n";
+        return 1;
+    }
+    std::cout << "All correctness checks passed\n";
+    return 0;
+}
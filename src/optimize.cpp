@@ -1,11 +1,13 @@
 #include <iostream>
 #include <fstream>
 #include <chrono>
-#include <numeric>
+#include <cmath>
+#include <limits>
 #include "Link.h"
 #include "FourBarMechanism.h"
 #include "CouplerHead.h"
 #include "Field.h"
+#include "CycleEvaluation.h"
 #include "Optimizer.h"
 
 constexpr double std_mass_linear_density = 1.0; // Kg/m
@@ -13,77 +15,42 @@ constexpr double button_radius = 0.0142;
 constexpr double hitbox_radius = button_radius / 1.41421356237; // radius / sqrt(2)
 constexpr double PI = 3.14159265358979323846;
 
-double fitnessFunction(FourBarMechanism mechanism)
+// The same for every call, the evaluation only reads it. Not a StaticField: its faster queries did not make evaluateCycle faster (0.96x)
+const Field playing_field({ButtonPair{0.1143, 0.3429, hitbox_radius, 0.163322, 0.329692, hitbox_radius}, ButtonPair{0.254, 0.381, hitbox_radius, 0.3048, 0.381, hitbox_radius}, ButtonPair{0.408686, 0.315214, hitbox_radius, 0.4445, 0.2794, hitbox_radius}});
+
+// The Optimizer gives the fitness of the worst survivor of the last generation as cutoff, a mechanism that can not beat it
+// is rejected before it is moved, with an infinite fitness
+double fitnessFunction(const FourBarMechanism &mechanism, double cutoff)
 {
-    Field playing_field({ButtonPair{0.1143, 0.3429, hitbox_radius, 0.163322, 0.329692, hitbox_radius}, ButtonPair{0.254, 0.381, hitbox_radius, 0.3048, 0.381, hitbox_radius}, ButtonPair{0.408686, 0.315214, hitbox_radius, 0.4445, 0.2794, hitbox_radius}});
-    double angle = 0;
     double fitness = 0;
-    double angle_step = 0.001;
-    double dt = 0.01;
-    bool was_button_pressed[3] = {false, false, false};
-    std::vector<double> energies;
-    long count = 0;
     std::cout << "Fitness function called" << std::endl;
-    while (angle < 2 * PI)
+    // The energies are only sampled at the first two crank angles, 0 and angle_step
+    // Only the crank angles at which the linkage closes are simulated, in uniform steps of angle_step
+    CycleOptions options;
+    options.angle_step = 0.001;
+    options.dt = 0.01;
+    options.energy_samples = 2;
+    // The energy terms are at least -energy_samples * 1000, so with fewer buttons pressed the fitness is above the cutoff
+    if (std::isfinite(cutoff))
     {
-        try
-        {
-            mechanism.rotate(angle, dt);
-            for (int i = 0; i < 3; i++)
-            {
-                auto [pos1, pos2] = mechanism.getCouplerHeadTopPositions();
-                int button_index = playing_field.getButtonPairPressedIndex(pos1, pos2);
-                if (button_index != -1)
-                {
-                    was_button_pressed[button_index] = true;
-                }
-            }
-            if (count < 2)
-            {
-                double energy = mechanism.getTotalEnergy();
-                if (!std::isnan(energy) && !std::isnan(-energy))
-                {
-                    energies.push_back(energy);
-                }
-            }
-        }
-        catch (...)
-        {
-        }
-        angle += angle_step;
-        count++;
+        options.min_buttons_pressed = (int)std::ceil(3 - options.energy_samples - cutoff / 1000);
     }
-    double energy_mean = std::accumulate(energies.begin(), energies.end(), 0.0) / energies.size();
-
-    for (auto energy : energies)
+    CycleResult cycle = evaluateCycle(mechanism, playing_field, options);
+    if (cycle.aborted)
     {
-        std::cout << energy << ",";
+        return std::numeric_limits<double>::infinity();
     }
-    std::cout << std::endl;
-    std::vector<double> deviation_from_the_mean;
-    for (auto energy : energies)
-    {
-        deviation_from_the_mean.push_back(std::abs(energy - energy_mean));
-    }
-    double average_deviation_from_the_mean = std::accumulate(deviation_from_the_mean.begin(), deviation_from_the_mean.end(), 0.0) / deviation_from_the_mean.size();
-    if (!std::isnan(average_deviation_from_the_mean))
-    {
-        fitness += 1 * average_deviation_from_the_mean;
-    }
-    fitness -= energies.size() * 1000;
+
+    // With two samples the standard deviation is the average deviation from the mean
+    fitness += 1 * cycle.energy_deviation;
+    fitness -= cycle.energy_samples * 1000;
     /*
     if (was_button_pressed[0] || was_button_pressed[1] || was_button_pressed[2] == false)
     {
         fitness = std::numeric_limits<double>::infinity();
     }
     */
-    for (int i = 0; i < 3; i++)
-    {
-        if (was_button_pressed[i] == false)
-        {
-            fitness += 1000;
-        }
-    }
+    fitness += (3 - cycle.buttons_pressed) * 1000;
     std::cout << "Fitness: " << fitness << std::endl;
     return fitness;
 }